@@ -55,10 +55,27 @@ END_LEGAL */
 #include <fstream>
 #include <cstdlib>
 #include <map>
+#include <deque>
+#include <cstddef>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include "pin.H"
 #include "instlib.H"
+#include "control_manager.H"
+#ifdef BRANCH_SIM
+// Online simulation build (make sim): the predictors of ../src run on the
+// branches instead of a trace being written. STATIC is also a Pin CRT macro
+#undef STATIC
+#include "predictor.h"
+#include "ittage.h"
+#include "ras.h"
+#endif
 
 using namespace std;
+using namespace CONTROLLER;
 
 #define axuliryFileName "generalInfo"
 std::map<ADDRINT, std::string> disAssemblyMap;
@@ -67,26 +84,190 @@ static ADDRINT dl_debug_state_Addr = 0;
 static ADDRINT dl_debug_state_AddrEnd = 0;
 static BOOL justFoundDlDebugState = FALSE;
 
-ofstream OutFile;
-ofstream axuFile;
-// The running count of instructions is kept here
-// make it static to help the compiler optimize docount
-static UINT64 icount = 0;
-static UINT64 cbcount = 0;
-static UINT64 ubcount = 0;
-static UINT64 callcount = 0;
-static UINT64 retcount = 0;
 static int64_t howManyBranch = 0;
 static UINT64 howManySet = 0;
-static UINT64 fileCounter = 0;
 static UINT64 offset_inst = 0;
-static UINT64 first_inst_count_after_offset = 0;
-static bool first_record = true;
-static bool record = false;
-static ostringstream filePrefix;
+
+// Region of interest, started and stopped by the InstLib controller
+// (-skip/-length, -start_address/-stop_address, -control with marker
+// instructions, ..., the whole program by default). Code runs without any
+// instrumentation of this tool outside of it; -f, -m and -b count the
+// instructions inside of it
+static CONTROL_MANAGER control;
+static BOOL roiActive = FALSE;
 
 static UINT64 CBCOUNT_LIMIT = 10000000;
-static UINT64 prev_cbcount = -1;
+
+// Instructions are counted per run of a basic block; docount() only has
+// to be replayed for the runs reaching checkCount, the next count at
+// which it may start recording, cut a set or print the progress
+#define PROGRESS_INTERVAL (1 << 24)
+
+// Branch record filled inline into the trace buffer
+#define BR_COND 1
+#define BR_CALL 2
+#define BR_RET 4
+#define BR_DIRECT 8
+
+struct BRANCH_RECORD
+{
+    ADDRINT pc;
+    ADDRINT target;
+    UINT32 flags; // BR_* known at instrumentation time
+    BOOL taken;
+};
+
+// Binary output (-binary), keep in sync with src/bintrace.h: a 32-byte
+// header, then per record the flags byte, the pc minus the previous pc
+// and the target minus the pc, as zigzag LEB128 varints (version 2)
+#define BT_MAGIC "BPTR"
+#define BT_VERSION 2
+#define BT_TAKEN 0x01
+#define BT_COND 0x02
+#define BT_CALL 0x04
+#define BT_RET 0x08
+#define BT_DIRECT 0x10
+#define BT_MAX_DELTA 10
+
+struct BT_HEADER
+{
+    char magic[4];
+    UINT16 version;
+    UINT8 addr_bytes;
+    UINT8 record_bytes;
+    UINT64 offset;
+    INT64 limit;
+    UINT32 set;
+    UINT32 reserved;
+};
+
+#define NUM_BUF_PAGES 1024       // trace buffer size, in pages
+#define NUM_FORMAT_RECORDS 4096  // records formatted before each write
+
+// Sets (-m/-b) are cut by docount() at an instruction count, while the
+// branches before the cut may still sit in the buffer: the cut is queued
+// with the counters of the finished set and applied by the writer once
+// it has written that many records
+struct FILE_SPLIT
+{
+    UINT64 records;
+    UINT64 instructions;
+    UINT64 ubcount;
+    UINT64 cbcount;
+    UINT64 callcount;
+    UINT64 retcount;
+    BOOL shard;          // a possible shard cut inside of the set
+    UINT64 icount;       // instruction count of the thread at the cut
+};
+
+// Shards (-shard_records/-shard_bytes) bound the size of the trace files:
+// every set is written to <prefix>_<n>_<shard>.out files, each a trace of
+// its own, listed in <prefix>_<n>.manifest. The threads queue a possible
+// cut every shardStep records, at the start of a run of instructions, so
+// the instruction range of a shard is exact; the writer cuts at each of
+// them (-shard_records) or at the first one past the size (-shard_bytes)
+#define SHARD_GRAIN 65536    // records between the possible cuts of -shard_bytes
+
+static UINT64 shardStep = 0;   // 0: one file per set, no manifest
+static UINT64 shardBytes = 0;
+static UINT32 cksumTable[256];
+
+// Every application thread counts its own instructions and branches,
+// cuts its own sets and writes its own trace: <prefix>_<n>.out for the
+// main thread, <prefix>_t<i>_<n>.out for the i-th thread started (same
+// for the generalInfo files). Reached from Pin TLS in callbacks and
+// through a tool register in the inlined analysis routines
+struct THREAD_DATA
+{
+    // The running count of instructions is kept here
+    UINT64 icount;
+    UINT64 cbcount;
+    UINT64 ubcount;
+    UINT64 callcount;
+    UINT64 retcount;
+    UINT64 recordcount;  // branches appended to the buffer
+    UINT64 checkCount;
+    UINT64 fileCounter;
+    ADDRINT recording;   // this thread is between its offset and its last set
+    BOOL started;        // reached its offset, its output is open
+    UINT64 lastSet;      // set the trace ended in, and the instruction
+    UINT64 endIcount;    // count it ended at, frozen when it stops
+
+    THREADID tid;
+    UINT32 index;        // order of creation, 0 for the main thread
+    UINT32 writer;       // writer thread owning the output of this thread
+    ofstream OutFile;
+    INT32 OutPipe;       // compressor reading the set, replaces OutFile (-compress)
+    pid_t OutPid;        // and its process
+    string OutName;      // file being written, for errors
+    ofstream axuFile;
+    UINT64 writtencount; // branches written to OutFile
+    UINT64 writeCounter; // set OutFile belongs to
+    ADDRINT lastPc;      // of the previous binary record of the set
+    UINT64 nextShard;    // recordcount of the next possible shard cut
+    ofstream manifest;
+    UINT64 shardCounter;
+    UINT64 shardRecord;  // writtencount at the start of the shard
+    UINT64 shardIcount;  // instruction count at the start of the shard
+    UINT64 shardSize;    // bytes written to the shard, before compression
+    UINT32 shardCksum;
+    PIN_LOCK splitLock;
+    std::deque<FILE_SPLIT> pendingSplits;
+    BOOL closed;
+    char text[NUM_FORMAT_RECORDS * 48];  // formatted records
+};
+
+static TLS_KEY threadKey;
+static REG threadReg;
+static PIN_LOCK threadsLock;
+static std::deque<THREAD_DATA *> threads;   // in creation order
+
+// Filled buffers are copied into one of NUM_WRITE_CHUNKS chunks and
+// handed to a pool of internal writer threads, so the application threads
+// neither format records nor wait for the compressor. The output of a
+// thread is always written by the same writer, which keeps it in order.
+// Once the writers have exited (process exit), buffers are written by the
+// thread that filled them
+#define NUM_WRITER_THREADS 2
+#define NUM_WRITE_CHUNKS 8
+
+struct WRITE_CHUNK
+{
+    THREAD_DATA *owner;
+    BRANCH_RECORD *records;  // NULL: the owner exited, close its output
+    UINT64 count;
+};
+
+struct WRITER
+{
+    PIN_SEMAPHORE chunkReady;  // set when fullChunks is not empty
+    std::deque<WRITE_CHUNK> fullChunks;
+    BOOL done;                 // exited, or could not be started
+    PIN_THREAD_UID uid;
+};
+
+static BUFFER_ID bufId;
+static PIN_LOCK chunkLock;
+static PIN_SEMAPHORE chunkFree;    // set when freeChunks is not empty
+static std::deque<BRANCH_RECORD *> freeChunks;
+static WRITER writers[NUM_WRITER_THREADS];
+static BOOL writerExiting = FALSE;
+
+// Basic block vectors (-bbv): instead of tracing, the instructions the
+// main thread executes in each block are summed per interval of the
+// region and written to <prefix>.bb as SimPoint frequency vectors
+struct BBV_BLOCK
+{
+    UINT64 count;  // instructions executed in the current interval
+    UINT32 id;     // 1-based, in order of first instrumentation
+};
+
+static UINT64 bbvInterval = 0;
+static UINT64 bbvNext = 0;      // main thread count closing the interval
+static PIN_LOCK bbvLock;
+static std::map<ADDRINT, BBV_BLOCK *> bbvBlocks;
+static std::deque<BBV_BLOCK *> bbvOrder;   // by id
+static ofstream bbvFile;
 
 KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "branches", "specifies the output file name prefix.");
 
@@ -94,107 +275,610 @@ KNOB<string> KnobHowManySet(KNOB_MODE_WRITEONCE, "pintool", "b", "1", "Specifies
 
 KNOB<string> KnobHowManyBranch(KNOB_MODE_WRITEONCE, "pintool", "m", "-1", "Specifies how many instructions should be probed. -1 for probing whole program.");
 
-KNOB<string> KnobOffset(KNOB_MODE_WRITEONCE, "pintool", "f", "20000000", "Starts saving instructions after seeing the first `f` instruction.");
+KNOB<string> KnobOffset(KNOB_MODE_WRITEONCE, "pintool", "f", "20000000", "Starts saving instructions after seeing the first `f` instruction of the region.");
+
+KNOB<BOOL> KnobCompress(KNOB_MODE_WRITEONCE, "pintool", "compress", "0", "Pipes every set through bzip2, writing <prefix>_<n>.out.bz2.");
+
+KNOB<BOOL> KnobBinary(KNOB_MODE_WRITEONCE, "pintool", "binary", "0", "Writes binary records (src/bintrace.h) instead of text lines.");
+
+KNOB<UINT64> KnobShardRecords(KNOB_MODE_WRITEONCE, "pintool", "shard_records", "0", "Splits every set into shards of `shard_records` records, listed in <prefix>_<n>.manifest.");
+
+KNOB<UINT64> KnobShardBytes(KNOB_MODE_WRITEONCE, "pintool", "shard_bytes", "0", "Splits every set into shards of about `shard_bytes` bytes (before compression), listed in <prefix>_<n>.manifest.");
+
+KNOB<UINT64> KnobBbv(KNOB_MODE_WRITEONCE, "pintool", "bbv", "0", "Profiles basic block vectors every `bbv` instructions into <prefix>.bb instead of tracing (-f, -m and -b are ignored).");
 // KNOB<string> KnobOffset(KNOB_MODE_WRITEONCE, "pintool", "f", "0", "Starts saving instructions after seeing the first `f` instruction.");
 
-VOID write_on_axu()
+#ifdef BRANCH_SIM
+KNOB<string> KnobPredictor(KNOB_MODE_WRITEONCE, "pintool", "predictor", "gshare", "Predictor simulated on the branches: static, gshare, tournament, custom, bimode or yags.");
+
+KNOB<BOOL> KnobIttage(KNOB_MODE_WRITEONCE, "pintool", "ittage", "0", "Also predicts the targets of indirect jumps and calls with ITTAGE.");
+
+KNOB<UINT32> KnobRas(KNOB_MODE_WRITEONCE, "pintool", "ras", "0", "Also predicts returns with a return address stack of `ras` entries.");
+
+// The branches of all threads run through the one set of predictor
+// tables, in the order their buffers are handed to the writers
+static PIN_LOCK simLock;
+static UINT64 simBranches = 0;
+static UINT64 simMispredictions = 0;
+static UINT64 simIndirect = 0;
+static UINT64 simTargetMispredictions = 0;
+static UINT64 simReturns = 0;
+static UINT64 simReturnMispredictions = 0;
+#endif
+
+VOID write_on_axu(THREAD_DATA *t, UINT64 instructions, UINT64 ub, UINT64 cb, UINT64 calls, UINT64 rets)
 {
-    axuFile << "!!! Number of Instructions = " << (icount - offset_inst - ((fileCounter - 1) * howManyBranch) + 1) << endl;
-    axuFile << "!!! Number of Unconditional branches = " << ubcount << endl;
-    axuFile << "!!! Number of Conditional branches = " << cbcount << endl;
-    axuFile << "!!! Number of Call branches = " << callcount << endl;
-    axuFile << "!!! Number of Ret branches = " << retcount << endl;
+    t->axuFile << "!!! Number of Instructions = " << instructions << endl;
+    t->axuFile << "!!! Number of Unconditional branches = " << ub << endl;
+    t->axuFile << "!!! Number of Conditional branches = " << cb << endl;
+    t->axuFile << "!!! Number of Call branches = " << calls << endl;
+    t->axuFile << "!!! Number of Ret branches = " << rets << endl;
+
+    t->axuFile.close();
+}
 
-    axuFile.close();
+// Instructions of set 'set' when it ends at instruction count 'icount'
+UINT64 set_instructions(UINT64 set, UINT64 icount)
+{
+    return icount - offset_inst - (set * howManyBranch) + 1;
 }
 
+// POSIX cksum (CRC-32, polynomial 0x04c11db7, most significant bit
+// first), so a shard can be checked with 'bunzip2 -c <shard> | cksum'
+static VOID init_cksum()
+{
+    for (UINT32 i = 0; i < 256; i++)
+    {
+        UINT32 crc = i << 24;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+        cksumTable[i] = crc;
+    }
+}
+
+static UINT32 cksum_update(UINT32 crc, const char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = (crc << 8) ^ cksumTable[(crc >> 24) ^ static_cast<UINT8>(data[i])];
+    }
+    return crc;
+}
+
+// The length goes into the sum after the data, least significant byte first
+static UINT32 cksum_final(UINT32 crc, UINT64 size)
+{
+    for (; size; size >>= 8)
+    {
+        crc = (crc << 8) ^ cksumTable[(crc >> 24) ^ (size & 0xff)];
+    }
+    return ~crc;
+}
+
+// A trace that cannot be written completely is an error, not a shorter
+// trace
+static VOID output_failed(THREAD_DATA *t, const char *what)
+{
+    cerr << "Error: could not " << what << " " << t->OutName << endl;
+    PIN_ExitProcess(1);
+}
+
+VOID write_out(THREAD_DATA *t, const char *data, size_t size)
+{
+    if (shardStep)
+    {
+        t->shardCksum = cksum_update(t->shardCksum, data, size);
+        t->shardSize += size;
+    }
+    if (t->OutPipe < 0)
+    {
+        t->OutFile.write(data, size);
+        if (!t->OutFile)
+        {
+            output_failed(t, "write");
+        }
+        return;
+    }
+    // MSG_NOSIGNAL: a compressor that died is reported here, rather than
+    // its SIGPIPE killing the application
+    while (size)
+    {
+        ssize_t n = send(t->OutPipe, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            output_failed(t, "compress");
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+// Close the current set, waits for the compressor to finish it
+VOID close_out(THREAD_DATA *t)
+{
+    if (t->OutPipe < 0)
+    {
+        t->OutFile.close();
+        if (t->OutFile.fail())
+        {
+            output_failed(t, "write");
+        }
+        return;
+    }
+    close(t->OutPipe);
+    t->OutPipe = -1;
+    int status;
+    while (waitpid(t->OutPid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            output_failed(t, "compress");
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+    {
+        output_failed(t, "compress");
+    }
+}
+
+// Start bzip2 writing 'fileName' (no shell, any name is taken as is). It
+// reads from a socket, which unlike a pipe can be written without SIGPIPE
+static VOID start_compressor(THREAD_DATA *t, const string &fileName)
+{
+    int fd[2];
+    int out = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+    {
+        output_failed(t, "open");
+    }
+    // close-on-exec, so no other compressor holds this one's input open
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fd) < 0)
+    {
+        output_failed(t, "start bzip2 for");
+    }
+    t->OutPid = fork();
+    if (t->OutPid == 0)
+    {
+        dup2(fd[1], 0);
+        dup2(out, 1);
+        execlp("bzip2", "bzip2", "-c", (char *)NULL);
+        _exit(127);
+    }
+    close(fd[1]);
+    close(out);
+    if (t->OutPid < 0)
+    {
+        close(fd[0]);
+        output_failed(t, "start bzip2 for");
+    }
+    t->OutPipe = fd[0];
+}
+
+// '<name>_<counter><suffix>', with the thread index for all but the main
+// thread
+static string file_name(const string &name, THREAD_DATA *t, UINT64 counter, const char *suffix = ".out")
+{
+    ostringstream filePrefix;
+    filePrefix << name << "_";
+    if (t->index)
+    {
+        filePrefix << "t" << t->index << "_";
+    }
+    filePrefix << counter << suffix;
+    return filePrefix.str();
+}
+
+// Open the trace file of set 'counter', or its next shard
+static VOID open_out(THREAD_DATA *t, UINT64 counter)
+{
+    string fileName = file_name(KnobOutputFile.Value(), t, counter);
+    if (shardStep)
+    {
+        ostringstream shard;
+        shard << "_" << t->shardCounter << ".out";
+        fileName = file_name(KnobOutputFile.Value(), t, counter, shard.str().c_str());
+        t->shardRecord = t->writtencount;
+        t->shardSize = 0;
+        t->shardCksum = 0;
+    }
+    if (KnobCompress.Value())
+    {
+        t->OutName = fileName + ".bz2";
+        start_compressor(t, t->OutName);
+    }
+    else
+    {
+        t->OutName = fileName;
+        t->OutFile.open(fileName.c_str(), KnobBinary.Value() ? ios::out | ios::binary : ios::out);
+        if (!t->OutFile.is_open())
+        {
+            output_failed(t, "open");
+        }
+        t->OutFile.setf(ios::showbase);
+    }
+
+    if (KnobBinary.Value())
+    {
+        BT_HEADER header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BT_MAGIC, 4);
+        header.version = BT_VERSION;
+        header.addr_bytes = 8;
+        header.record_bytes = 0;
+        header.offset = offset_inst;
+        header.limit = howManyBranch;
+        header.set = counter;
+        write_out(t, reinterpret_cast<const char *>(&header), sizeof(header));
+        t->lastPc = 0;
+    }
+}
+
+// Start set 'counter': its trace file (first shard), generalInfo file
+// and manifest
+VOID open_files(THREAD_DATA *t, UINT64 counter)
+{
+    t->shardCounter = 0;
+    open_out(t, counter);
+
+    t->axuFile.open(file_name(axuliryFileName, t, counter).c_str());
+    t->axuFile.setf(ios::showbase);
+    if (shardStep)
+    {
+        t->manifest.open(file_name(KnobOutputFile.Value(), t, counter, ".manifest").c_str());
+        t->manifest << "# shard first_record records first_instruction instructions cksum bytes" << endl;
+    }
+}
+
+// List the shard being closed, which ends at instruction count 'icount'
+static VOID close_shard(THREAD_DATA *t, UINT64 icount)
+{
+    ostringstream shard;
+    shard << "_" << t->shardCounter << ".out" << (KnobCompress.Value() ? ".bz2" : "");
+    string fileName = file_name(KnobOutputFile.Value(), t, t->writeCounter, shard.str().c_str());
+    size_t slash = fileName.rfind('/');
+    if (slash != string::npos)
+    {
+        fileName = fileName.substr(slash + 1);   // next to the manifest
+    }
+    t->manifest << fileName << " " << t->shardRecord << " " << t->writtencount - t->shardRecord << " "
+                << t->shardIcount << " " << icount - t->shardIcount << " "
+                << cksum_final(t->shardCksum, t->shardSize) << " " << t->shardSize << endl;
+    t->shardIcount = icount;
+}
+
+static VOID next_file(THREAD_DATA *t);
+
+// Returns TRUE if a set split is queued at record count 'records', called
+// with splitLock held
+static BOOL set_ends_at(THREAD_DATA *t, UINT64 records)
+{
+    for (size_t i = 0; i < t->pendingSplits.size() && t->pendingSplits[i].records == records; i++)
+    {
+        if (!t->pendingSplits[i].shard)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Stop recording in set 'set' and freeze the end of the trace, while the
+// thread keeps counting instructions until it exits
+static VOID end_trace(THREAD_DATA *t, UINT64 set)
+{
+    t->recording = 0;
+    t->lastSet = set;
+    t->endIcount = t->icount;
+}
+
+// Write the last set of a thread once all its records were written out.
+// A thread that never reached its offset has no output
+static VOID finish_output(THREAD_DATA *t)
+{
+    if (t->recording)
+    {
+        end_trace(t, t->fileCounter);   // exited inside of its last set
+    }
+#ifdef BRANCH_SIM
+    t->closed = TRUE;
+    return;
+#endif
+    if (!t->started)
+    {
+        t->closed = TRUE;
+        return;
+    }
+    PIN_GetLock(&t->splitLock, t->tid + 1);
+    while (!t->pendingSplits.empty())
+    {
+        if (t->pendingSplits.front().shard)
+        {
+            t->pendingSplits.pop_front();   // the last shard ends with the trace
+            continue;
+        }
+        next_file(t);
+    }
+    PIN_ReleaseLock(&t->splitLock);
+    write_on_axu(t, set_instructions(t->lastSet, t->endIcount), t->ubcount, t->cbcount, t->callcount,
+                 t->retcount);
+    if (shardStep)
+    {
+        close_shard(t, t->endIcount);
+        t->manifest.close();
+    }
+    close_out(t);
+    t->closed = TRUE;
+}
+
+#ifdef BRANCH_SIM
+// Instructions a thread counted between its offset and the end of its
+// last set
+static UINT64 simulated_instructions(THREAD_DATA *t)
+{
+    if (!t->started)
+    {
+        return 0;
+    }
+    return (t->recording ? t->icount : t->endIcount) - offset_inst;   // still running
+}
+
+// The statistics src/predictor prints for a trace of the same branches
+static VOID print_simulation()
+{
+    UINT64 instructions = 0;
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        instructions += simulated_instructions(threads[i]);
+    }
+    printf("Branches:        %10llu\n", (unsigned long long)simBranches);
+    printf("Incorrect:       %10llu\n", (unsigned long long)simMispredictions);
+    printf("Misprediction Rate: %7.3f\n", 1000 * ((double)simMispredictions / (double)simBranches));
+    if (instructions)
+    {
+        printf("MPKI:            %10.3f\n", 1000 * ((double)simMispredictions / (double)instructions));
+        printf("Branch Density:  %10.3f\n", 1000 * ((double)simBranches / (double)instructions));
+    }
+    print_predictor_stats();
+    if (ittage)
+    {
+        printf("Indirect:        %10llu\n", (unsigned long long)simIndirect);
+        printf("Target Incorrect:%10llu\n", (unsigned long long)simTargetMispredictions);
+        printf("Target Misprediction Rate: %7.3f\n", 1000 * ((double)simTargetMispredictions / (double)simIndirect));
+        if (instructions)
+        {
+            printf("Target MPKI:     %10.3f\n", 1000 * ((double)simTargetMispredictions / (double)instructions));
+        }
+        cleanup_ittage();
+    }
+    if (rasDepth)
+    {
+        printf("Returns:         %10llu\n", (unsigned long long)simReturns);
+        printf("Return Incorrect:%10llu\n", (unsigned long long)simReturnMispredictions);
+        printf("Return Misprediction Rate: %7.3f\n", 1000 * ((double)simReturnMispredictions / (double)simReturns));
+        if (instructions)
+        {
+            printf("Return MPKI:     %10.3f\n", 1000 * ((double)simReturnMispredictions / (double)instructions));
+        }
+        printf("RAS %d:%s:%s Overflows: %u Underflows: %u\n", rasDepth,
+               rasOverflowName[rasOverflow], rasRepairName[rasRepair], ras_overflows, ras_underflows);
+        cleanup_ras();
+    }
+    fflush(stdout);
+}
+#endif
+
+// Write the vector of the interval that just ended and start a new one
+static VOID write_bbv()
+{
+    PIN_GetLock(&bbvLock, 1);
+    bbvFile << "T";
+    for (size_t i = 0; i < bbvOrder.size(); i++)
+    {
+        if (bbvOrder[i]->count)
+        {
+            bbvFile << ":" << bbvOrder[i]->id << ":" << bbvOrder[i]->count << " ";
+            bbvOrder[i]->count = 0;
+        }
+    }
+    bbvFile << endl;
+    PIN_ReleaseLock(&bbvLock);
+}
+
+// Runs after the buffers of all threads were written out
 VOID Fini(INT32 code, VOID *v)
 {
     // Write to a file since cout and cerr maybe closed by the application
     cout << "Logging data..." << endl;
-    write_on_axu();
-    OutFile.close();
+    if (bbvInterval)
+    {
+        // the last, partial interval, simpoint weights it by its size
+        if (!threads.empty() && threads[0]->icount + bbvInterval > bbvNext)
+        {
+            write_bbv();
+        }
+        bbvFile.close();
+        return;
+    }
+#ifdef BRANCH_SIM
+    print_simulation();
+    return;
+#endif
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        if (!threads[i]->closed)
+        {
+            finish_output(threads[i]);
+        }
+    }
 }
 
-VOID reset_var()
+VOID reset_var(THREAD_DATA *t)
 {
-    cbcount = 0;
-    ubcount = 0;
-    callcount = 0;
-    retcount = 0;
-    first_inst_count_after_offset = 0;
+    t->cbcount = 0;
+    t->ubcount = 0;
+    t->callcount = 0;
+    t->retcount = 0;
 }
 
-UINT32 file_init()
+UINT32 file_init(THREAD_DATA *t)
 {
-    cout << "Writing " << fileCounter - 1 << endl;
+    cout << "Writing " << t->fileCounter - 1 << " (thread " << t->index << ")" << endl;
 
-    write_on_axu();
+#ifndef BRANCH_SIM
+    FILE_SPLIT split = {t->recordcount, set_instructions(t->fileCounter - 1, t->icount), t->ubcount, t->cbcount,
+                        t->callcount, t->retcount, FALSE, t->icount};
+    PIN_GetLock(&t->splitLock, t->tid + 1);
+    t->pendingSplits.push_back(split);
+    PIN_ReleaseLock(&t->splitLock);
+#endif
+    if (shardStep)
+    {
+        t->nextShard = t->recordcount + shardStep;   // shards restart with the set
+    }
 
-    OutFile.close();
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << KnobOutputFile.Value() << "_" << fileCounter << ".out";
-    OutFile.open(filePrefix.str().c_str());
-    OutFile.setf(ios::showbase);
+    reset_var(t);
 
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << axuliryFileName << "_" << fileCounter << ".out";
-    axuFile.open(filePrefix.str().c_str());
-    axuFile.setf(ios::showbase);
+    return 0;
+}
 
-    reset_var();
+// The thread reached its offset: open its first set and record
+static VOID start_thread(THREAD_DATA *t)
+{
+    t->started = TRUE;
+    t->recording = 1;
+    if (shardStep)
+    {
+        t->nextShard = t->recordcount + shardStep;
+    }
+#ifndef BRANCH_SIM
+    if (!bbvInterval)
+    {
+        open_files(t, 0);
+    }
+#endif
+}
 
-    return 0;
+// The thread is done with set 'set': the main thread ends the program,
+// the other ones stop recording
+static VOID stop_thread(THREAD_DATA *t, UINT64 set)
+{
+    end_trace(t, set);
+    t->fileCounter = howManySet;
+    if (t->index == 0)
+    {
+        PIN_ExitApplication(0); // flushes the buffers, then calls Fini
+    }
 }
 
-// This function is called before every instruction is executed
-VOID docount()
+// Per instruction logic, replayed by CheckLimits() for every instruction
+// of a run reaching checkCount
+VOID docount(THREAD_DATA *t)
 {
-    // cerr<< "I:" << icount << "V:" << (howManyBranch+ offset_inst - 1) << (!((icount) % (howManyBranch+ offset_inst - 1))? "Tr":"Fa") << endl;
-    if (howManyBranch > 0)
+    if (howManyBranch > 0 && t->fileCounter < howManySet)
     {
-        if (!((icount) % ((howManyBranch * (fileCounter + 1)) + offset_inst - 1)) && icount > 0)
+        if (!((t->icount) % ((howManyBranch * (t->fileCounter + 1)) + offset_inst - 1)) && t->icount > 0)
         {
-            fileCounter++;
-            if (fileCounter > howManySet - 1)
+            t->fileCounter++;
+            if (t->fileCounter > howManySet - 1)
             {
-                cout << "Exiting because of user conditions" << endl;
-                Fini(0, 0);
-                exit(0);
+                cout << "Exiting because of user conditions (thread " << t->index << ")" << endl;
+                stop_thread(t, t->fileCounter - 1);
             }
             else
             {
-                file_init();
+                file_init(t);
             }
         }
     }
 
-    icount++;
+    t->icount++;
 
-    if (cbcount != prev_cbcount && cbcount % 10000 == 0)
-        cout << icount << " "<< cbcount << endl;
-    prev_cbcount = cbcount;
+    if (t->cbcount >= CBCOUNT_LIMIT && t->recording)
+    {
+        cout << "Exiting because of CBCOUNT_LIMIT (thread " << t->index << ")" << endl;
+        stop_thread(t, t->fileCounter);
+    }
 
-    if (cbcount >= CBCOUNT_LIMIT)
+    if (t->icount >= offset_inst && !t->started)
     {
-        fileCounter++;
-        cout << "Exiting because of CBCOUNT_LIMIT" << endl;
-        Fini(0, 0);
-        exit(0);
+        start_thread(t);
     }
+}
 
-    if (icount >= offset_inst && fileCounter == 0)
+// Lowest instruction count at which docount() may act: the start of the
+// recording, the next multiple of the set period or the next progress line
+VOID set_check_count(THREAD_DATA *t)
+{
+    UINT64 next = (t->icount / PROGRESS_INTERVAL + 1) * PROGRESS_INTERVAL;
+    if (!t->started && offset_inst < next)
     {
-        // cout << "Here!" << endl;
-        first_inst_count_after_offset++; // Although here is going to be increased by one, it will be set to 1 whenever it reaches to fist branch;
-        record = true;
+        next = offset_inst;
     }
-    else if (fileCounter > 0)
+    if (howManyBranch > 0 && t->fileCounter < howManySet)
     {
-        first_inst_count_after_offset++;
+        UINT64 period = (howManyBranch * (t->fileCounter + 1)) + offset_inst - 1;
+        if (period > 0)
+        {
+            UINT64 cut = (t->icount / period + (t->icount % period != 0)) * period;
+            if (cut == 0)
+            {
+                cut = period;
+            }
+            if (cut < next)
+            {
+                next = cut;
+            }
+        }
     }
+    if (bbvInterval && t->index == 0 && bbvNext < next)
+    {
+        next = bbvNext;
+    }
+    t->checkCount = next;
+}
+
+// Inlined before every run of 'numIns' instructions
+static ADDRINT CountBlock(THREAD_DATA *t, UINT32 numIns)
+{
+    t->icount += numIns;
+    return (t->icount >= t->checkCount) | ((t->cbcount >= CBCOUNT_LIMIT) & t->recording) |
+           (t->recordcount >= t->nextShard);
+}
+
+// Called when the run may reach a limit: count it instruction by instruction
+static VOID CheckLimits(THREAD_DATA *t, UINT32 numIns)
+{
+    UINT64 start = t->icount - numIns;
+    t->icount = start;
+    if (t->recordcount >= t->nextShard)
+    {
+        // the branches so far end before this run
+        FILE_SPLIT split = {t->recordcount, 0, 0, 0, 0, 0, TRUE, start};
+        PIN_GetLock(&t->splitLock, t->tid + 1);
+        t->pendingSplits.push_back(split);
+        PIN_ReleaseLock(&t->splitLock);
+        t->nextShard = t->recordcount + shardStep;
+    }
+    for (UINT32 i = 0; i < numIns; i++)
+    {
+        docount(t);
+    }
+    if (t->icount / PROGRESS_INTERVAL != start / PROGRESS_INTERVAL)
+    {
+        cout << t->icount << " " << t->cbcount << " (thread " << t->index << ")" << endl;
+    }
+    while (bbvInterval && t->index == 0 && t->icount >= bbvNext)
+    {
+        write_bbv();
+        bbvNext += bbvInterval;
+    }
+    set_check_count(t);
 }
 
 VOID ImageLoad(IMG img, VOID *v)
@@ -225,302 +909,529 @@ VOID ImageLoad(IMG img, VOID *v)
 
 /************
  *
- * JMP segment
+ * Branch records
+ *
+ * Every branch is appended inline to the Pin trace buffer of its thread;
+ * full buffers are formatted and written in bulk by a writer thread (and,
+ * with -compress, compressed by a bzip2 process reading the set as it is
+ * written). Only the counters are updated by a (small, inlined) analysis
+ * routine.
  *
  */
 
-static VOID UnconDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t0"                         // Unconditional
-            << "\t0"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-}
-
-static VOID UnconUnDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t0"                         // Unconditional
-            << "\t0"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t0"                         // Not Direct
-            << "\n"
-            << flush;
-    ubcount++;
-}
-
-static VOID ConDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t1"                         // Conditional
-            << "\t0"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-}
-static VOID ConUnDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t1"                         // Conditional
-            << "\t0"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t0"                         // Not Direct
-            << "\n"
-            << flush;
-    cbcount++;
+static ADDRINT IsRecording(THREAD_DATA *t)
+{
+    return t->recording;
 }
-//****************************************************************
 
-/************
- *
- * Ret segment
- *
- */
+static VOID CountBranch(THREAD_DATA *t, UINT32 flags)
+{
+    t->cbcount += flags & BR_COND;
+    t->ubcount += ~flags & BR_COND;
+    t->callcount += (flags & BR_CALL) >> 1;
+    t->retcount += (flags & BR_RET) >> 2;
+    t->recordcount++;
+}
 
-static VOID UnconDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t0"                         // Unconditional
-            << "\t0"                         // Not Call
-            << "\t1"                         // Ret
-            << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    retcount++;
-}
-
-static VOID UnconUnDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t0"                         // Unconditional
-            << "\t0"                         // Not Call
-            << "\t1"                         // Ret
-            << "\t0"                         // Not Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    retcount++;
-}
-
-static VOID ConDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t1"                         // Unconditional
-            << "\t0"                         // Not Call
-            << "\t1"                         // Not Ret
-            << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    retcount++;
-}
-static VOID ConUnDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t1"                         // Unconditional
-            << "\t0"                         // Not Call
-            << "\t1"                         // Not Ret
-            << "\t0"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    retcount++;
+// Write 'delta' as a zigzag LEB128 varint
+static char *put_delta(char *p, INT64 delta)
+{
+    UINT64 value = (static_cast<UINT64>(delta) << 1) ^ static_cast<UINT64>(delta >> 63);
+    while (value >= 0x80)
+    {
+        *p++ = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    *p++ = static_cast<char>(value);
+    return p;
 }
-//****************************************************************
 
-/************
- *
- * Call segment
- *
- */
-static VOID UnconDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t0"                         // Unconditional
-            << "\t1"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    callcount++;
-}
-static VOID UnconUnDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t0"                         // Unconditional
-            << "\t1"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t0"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    callcount++;
-}
-static VOID ConDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t1"                         // Unconditional
-            << "\t1"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    callcount++;
-}
-static VOID ConUnDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
-{
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
-            << (taken ? "\t1" : "\t0")       // T-N
-            << "\t1"                         // Unconditional
-            << "\t1"                         // Not Call
-            << "\t0"                         // Not Ret
-            << "\t0"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    callcount++;
+// Write 'value' as lowercase hex with a 0x prefix
+static char *put_hex(char *p, UINT64 value)
+{
+    char digits[16];
+    int n = 0;
+    do
+    {
+        digits[n++] = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    } while (value);
+    *p++ = '0';
+    *p++ = 'x';
+    while (n)
+    {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+// Start the next output set once the records of the current one are
+// written, called with splitLock held
+static VOID next_file(THREAD_DATA *t)
+{
+    FILE_SPLIT split = t->pendingSplits.front();
+    t->pendingSplits.pop_front();
+    if (split.shard)
+    {
+        if (t->shardSize < shardBytes || t->writtencount == t->shardRecord || set_ends_at(t, split.records))
+        {
+            return;   // -shard_bytes and not full yet, empty, or the set ends here
+        }
+        close_shard(t, split.icount);
+        close_out(t);
+        t->shardCounter++;
+        open_out(t, t->writeCounter);
+        return;
+    }
+    write_on_axu(t, split.instructions, split.ubcount, split.cbcount, split.callcount, split.retcount);
+    if (shardStep)
+    {
+        close_shard(t, split.icount);
+        t->manifest.close();
+    }
+    close_out(t);
+    open_files(t, ++t->writeCounter);
+}
+
+#ifdef BRANCH_SIM
+// Predict and train on 'numElements' records of thread 't', in the order
+// of the main loop of src/predictor
+static VOID simulate_records(THREAD_DATA *t, BRANCH_RECORD *record, UINT64 numElements)
+{
+    PIN_GetLock(&simLock, t->tid + 1);
+    for (UINT64 i = 0; i < numElements; i++, record++)
+    {
+        uint64_t pc = record->pc;
+        uint64_t target = record->target;
+        uint32_t outcome = record->taken ? TAKEN : NOTTAKEN;
+        uint32_t condition = (record->flags & BR_COND) != 0;
+        uint32_t call = (record->flags & BR_CALL) != 0;
+        uint32_t ret = (record->flags & BR_RET) != 0;
+        uint32_t direct = (record->flags & BR_DIRECT) != 0;
+
+        if (condition)
+        {
+            simBranches++;
+            if (make_prediction(pc, target, direct) != outcome)
+            {
+                simMispredictions++;
+                if (rasDepth)
+                {
+                    ras_mispredict();
+                }
+            }
+        }
+        if (ittage && !direct && !ret)
+        {
+            simIndirect++;
+            simTargetMispredictions += ittage_predict(pc) != target;
+        }
+        if (rasDepth && ret)
+        {
+            simReturns++;
+            simReturnMispredictions += !ras_match(ras_predict(), target);
+        }
+
+        if (ittage)
+        {
+            train_ittage(pc, target, outcome, condition, ret, direct);
+        }
+        if (rasDepth)
+        {
+            train_ras(pc, call, ret);
+        }
+        train_predictor(pc, target, outcome, condition, call, ret, direct);
+    }
+    t->writtencount += numElements;
+    PIN_ReleaseLock(&simLock);
 }
-//****************************************************************
 
-static VOID Instruction(INS ins, VOID *v)
+// Configure and initialize the simulated predictors from the knobs
+static BOOL init_simulation()
 {
-    // Insert a call to docount before every instruction, no arguments are passed
+    for (bpType = STATIC; bpType <= YAGS; bpType++)
+    {
+        if (!strcasecmp(KnobPredictor.Value().c_str(), bpName[bpType]))
+        {
+            break;
+        }
+    }
+    if (bpType > YAGS)
+    {
+        return FALSE;
+    }
+    ittage = KnobIttage.Value();
+    rasDepth = KnobRas.Value();
+    PIN_InitLock(&simLock);
+    init_predictor();
+    if (ittage)
+    {
+        init_ittage();
+    }
+    if (rasDepth)
+    {
+        init_ras();
+    }
+    return TRUE;
+}
+#endif
 
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount, IARG_END);
+// Format and write 'numElements' records of thread 't'
+static VOID write_records(THREAD_DATA *t, BRANCH_RECORD *record, UINT64 numElements)
+{
+#ifdef BRANCH_SIM
+    simulate_records(t, record, numElements);
+    return;
+#endif
+    // '0x' + up to 16 digits, tab, twice, then 5 flags with their separators
+    char *text = t->text;
+    BOOL binary = KnobBinary.Value();
 
-    if (record)
+    PIN_GetLock(&t->splitLock, t->tid + 1);
+    char *p = text;
+    for (UINT64 i = 0; i < numElements; i++, record++)
     {
-        if (INS_IsValidForIpointTakenBranch(ins))
+        if (!t->pendingSplits.empty() && t->pendingSplits.front().records == t->writtencount)
         {
-            if (first_record)
-            { // Detected the first branch
-                first_inst_count_after_offset = 1;
-                first_record = false;
+            write_out(t, text, p - text);
+            p = text;
+            // every split queued at this count, a shard cut where the set
+            // ends is dropped
+            while (!t->pendingSplits.empty() && t->pendingSplits.front().records == t->writtencount)
+            {
+                next_file(t);
             }
-            if (INS_HasFallThrough(ins) == false)
-            { // It is unconditional branch
-                if (INS_IsCall(ins))
-                { // It is call
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    { // direct
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else if (INS_IsRet(ins))
-                { // It is RET
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else
-                { // It is JMP
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
+        }
+
+        if (binary)
+        {
+            *p++ = (record->taken ? BT_TAKEN : 0) | ((record->flags & BR_COND) ? BT_COND : 0) |
+                   ((record->flags & BR_CALL) ? BT_CALL : 0) | ((record->flags & BR_RET) ? BT_RET : 0) |
+                   ((record->flags & BR_DIRECT) ? BT_DIRECT : 0);
+            p = put_delta(p, record->pc - t->lastPc);
+            p = put_delta(p, record->target - record->pc);
+            t->lastPc = record->pc;
+            t->writtencount++;
+            if (p - text > (long)sizeof(t->text) - 48)
+            {
+                write_out(t, text, p - text);
+                p = text;
             }
-            else
-            { // It is conditional branch
-                if (INS_IsCall(ins))
-                { // It is call
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    { // direct
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else if (INS_IsRet(ins))
-                { // It is RET
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else
-                { // It is JMP
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
+            continue;
+        }
+
+        p = put_hex(p, record->pc);   // PC
+        *p++ = '\t';
+        p = put_hex(p, record->target);   // Target
+        *p++ = '\t';
+        *p++ = record->taken ? '1' : '0';   // T-N
+        *p++ = '\t';
+        *p++ = (record->flags & BR_COND) ? '1' : '0';   // Conditional
+        *p++ = '\t';
+        *p++ = (record->flags & BR_CALL) ? '1' : '0';   // Call
+        *p++ = '\t';
+        *p++ = (record->flags & BR_RET) ? '1' : '0';   // Ret
+        *p++ = '\t';
+        *p++ = (record->flags & BR_DIRECT) ? '1' : '0';   // Direct
+        *p++ = '\n';
+        t->writtencount++;
+
+        if (p - text > (long)sizeof(t->text) - 48)
+        {
+            write_out(t, text, p - text);
+            p = text;
+        }
+    }
+    PIN_ReleaseLock(&t->splitLock);
+    write_out(t, text, p - text);
+}
+
+// Queue the records of thread 't' (or, with no records, the end of its
+// output) for its writer thread, copying them to a free chunk
+//
+// Returns FALSE once the writer has exited
+static BOOL queue_records(THREAD_DATA *t, BRANCH_RECORD *records, UINT64 numElements)
+{
+    WRITER *w = &writers[t->writer];
+    PIN_GetLock(&chunkLock, t->tid + 1);
+    while (records && freeChunks.empty() && !w->done)
+    {
+        PIN_SemaphoreClear(&chunkFree);
+        PIN_ReleaseLock(&chunkLock);
+        PIN_SemaphoreWait(&chunkFree);
+        PIN_GetLock(&chunkLock, t->tid + 1);
+    }
+    if (w->done)
+    {
+        PIN_ReleaseLock(&chunkLock);
+        return FALSE;
+    }
+    WRITE_CHUNK chunk = {t, NULL, numElements};
+    if (records)
+    {
+        chunk.records = freeChunks.front();
+        freeChunks.pop_front();
+        memcpy(chunk.records, records, numElements * sizeof(BRANCH_RECORD));
+    }
+    w->fullChunks.push_back(chunk);
+    PIN_SemaphoreSet(&w->chunkReady);
+    PIN_ReleaseLock(&chunkLock);
+    return TRUE;
+}
+
+static VOID *BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf, UINT64 numElements, VOID *v)
+{
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(threadKey, tid));
+    if (!queue_records(t, static_cast<BRANCH_RECORD *>(buf), numElements))
+    {
+        write_records(t, static_cast<BRANCH_RECORD *>(buf), numElements);
+    }
+    return buf;
+}
+
+// Internal thread writing the queued chunks until the process exits
+static VOID WriterThread(VOID *arg)
+{
+    WRITER *w = static_cast<WRITER *>(arg);
+    THREADID tid = PIN_ThreadId();
+    for (;;)
+    {
+        PIN_GetLock(&chunkLock, tid + 1);
+        if (w->fullChunks.empty())
+        {
+            if (writerExiting)
+            {
+                // wake up the threads waiting for a chunk, they write themselves
+                w->done = TRUE;
+                PIN_SemaphoreSet(&chunkFree);
+                PIN_ReleaseLock(&chunkLock);
+                PIN_ExitThread(0);
             }
+            PIN_SemaphoreClear(&w->chunkReady);
+            PIN_ReleaseLock(&chunkLock);
+            PIN_SemaphoreWait(&w->chunkReady);
+            continue;
+        }
+        WRITE_CHUNK chunk = w->fullChunks.front();
+        w->fullChunks.pop_front();
+        PIN_ReleaseLock(&chunkLock);
+
+        if (!chunk.records)
+        {
+            finish_output(chunk.owner);
+            continue;
         }
+        write_records(chunk.owner, chunk.records, chunk.count);
+
+        PIN_GetLock(&chunkLock, tid + 1);
+        freeChunks.push_back(chunk.records);
+        PIN_SemaphoreSet(&chunkFree);
+        PIN_ReleaseLock(&chunkLock);
+    }
+}
+
+// Runs before the application threads exit: drain the queues and stop the
+// writers, the buffers flushed at thread exit are then written directly
+static VOID PrepareForFini(VOID *v)
+{
+    PIN_GetLock(&chunkLock, 0);
+    writerExiting = TRUE;
+    for (int i = 0; i < NUM_WRITER_THREADS; i++)
+    {
+        PIN_SemaphoreSet(&writers[i].chunkReady);
+    }
+    PIN_ReleaseLock(&chunkLock);
+    for (int i = 0; i < NUM_WRITER_THREADS; i++)
+    {
+        if (!writers[i].done)
+        {
+            PIN_WaitForThreadTermination(writers[i].uid, PIN_INFINITE_TIMEOUT, NULL);
+        }
+    }
+}
+
+static VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    THREAD_DATA *t = new THREAD_DATA();
+    t->tid = tid;
+    t->OutPipe = -1;
+    PIN_InitLock(&t->splitLock);
+
+    PIN_GetLock(&threadsLock, tid + 1);
+    t->index = threads.size();
+    threads.push_back(t);
+    PIN_ReleaseLock(&threadsLock);
+
+    t->writer = t->index % NUM_WRITER_THREADS;
+    t->nextShard = shardStep ? shardStep : ~0ULL;
+    t->shardIcount = offset_inst;
+    PIN_SetThreadData(threadKey, t, tid);
+    PIN_SetContextReg(ctxt, threadReg, reinterpret_cast<ADDRINT>(t));
+}
+
+// The last buffer of the thread was flushed: close its output after it
+static VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(threadKey, tid));
+    if (bbvInterval)
+    {
+        t->closed = TRUE;
+    }
+    else if (!queue_records(t, NULL, 0))
+    {
+        finish_output(t);
+    }
+}
+//****************************************************************
+
+static VOID Instruction(INS ins)
+{
+    if (INS_IsValidForIpointTakenBranch(ins))
+    {
+        UINT32 flags = 0;
+        if (INS_HasFallThrough(ins))
+        { // It is conditional branch
+            flags |= BR_COND;
+        }
+        if (INS_IsCall(ins))
+        { // It is call
+            flags |= BR_CALL;
+        }
+        else if (INS_IsRet(ins))
+        { // It is RET
+            flags |= BR_RET;
+        }
+        if (INS_IsDirectControlFlow(ins))
+        { // direct
+            flags |= BR_DIRECT;
+        }
+
+        // the code is shared, the threads before their offset or past
+        // their last set skip it
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)IsRecording, IARG_REG_VALUE, threadReg, IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)CountBranch, IARG_REG_VALUE, threadReg,
+                           IARG_UINT32, flags, IARG_END);
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)IsRecording, IARG_REG_VALUE, threadReg, IARG_END);
+        INS_InsertFillBufferThen(ins, IPOINT_BEFORE, bufId,
+                                 IARG_INST_PTR, offsetof(BRANCH_RECORD, pc),
+                                 IARG_BRANCH_TARGET_ADDR, offsetof(BRANCH_RECORD, target),
+                                 IARG_UINT32, flags, offsetof(BRANCH_RECORD, flags),
+                                 IARG_BRANCH_TAKEN, offsetof(BRANCH_RECORD, taken),
+                                 IARG_END);
     }
     // We do not care about instrunctions that are not branches.
     // else
     //    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)AtNonBranch, IARG_INST_PTR, IARG_END);
 }
 
+static VOID InsertCount(INS ins, UINT32 numIns)
+{
+    INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)CountBlock, IARG_REG_VALUE, threadReg,
+                     IARG_UINT32, numIns, IARG_END);
+    INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)CheckLimits, IARG_REG_VALUE, threadReg,
+                       IARG_UINT32, numIns, IARG_END);
+}
+
+// Inlined at the head of every block in -bbv mode, only the main thread
+// updates the shared counters
+static ADDRINT IsMainThread(THREAD_DATA *t)
+{
+    return t->index == 0;
+}
+
+static VOID BbvCount(UINT64 *counter, UINT32 numIns)
+{
+    *counter += numIns;
+}
+
+static BBV_BLOCK *bbv_block(BBL bbl)
+{
+    PIN_GetLock(&bbvLock, 1);
+    BBV_BLOCK *&block = bbvBlocks[BBL_Address(bbl)];
+    if (!block)
+    {
+        block = new BBV_BLOCK();
+        block->id = bbvOrder.size() + 1;
+        bbvOrder.push_back(block);
+    }
+    PIN_ReleaseLock(&bbvLock);
+    return block;
+}
+
+// Counted on the runs of InsertCount, so a REP iteration adds to the
+// vector the same instructions it adds to icount
+static VOID InsertBbvCount(BBV_BLOCK *block, INS ins, UINT32 numIns)
+{
+    INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)IsMainThread, IARG_REG_VALUE, threadReg, IARG_END);
+    INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)BbvCount, IARG_PTR, &block->count,
+                       IARG_UINT32, numIns, IARG_END);
+}
+
+static VOID Trace(TRACE trace, VOID *v)
+{
+    if (!roiActive)
+    {
+        return;
+    }
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    {
+        // One count per run of instructions. A REP instruction is counted
+        // once per iteration, like any IPOINT_BEFORE call, so it forms its
+        // own run. The counts go first: a cut before a branch leaves it to
+        // the next set
+        BBV_BLOCK *block = bbvInterval ? bbv_block(bbl) : NULL;
+        INS ins = BBL_InsHead(bbl);
+        while (INS_Valid(ins))
+        {
+            INS head = ins;
+            UINT32 numIns = 0;
+            do
+            {
+                numIns++;
+                ins = INS_Next(ins);
+            } while (INS_Valid(ins) && !INS_HasRealRep(ins) && !INS_HasRealRep(head));
+            InsertCount(head, numIns);
+            if (block)
+            {
+                InsertBbvCount(block, head, numIns);
+            }
+        }
+
+        if (bbvInterval)
+        {
+            continue;
+        }
+        for (ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins))
+        {
+            Instruction(ins);
+        }
+    }
+}
+
+// Controller events: swap the instrumentation of the whole code cache and
+// re-run the current trace with the new one, so the region is exact
+static VOID RegionHandler(EVENT_TYPE ev, VOID *v, CONTEXT *ctxt, VOID *ip, THREADID tid, BOOL bcast)
+{
+    switch (ev)
+    {
+    case EVENT_START:
+        cout << "Region start (thread " << tid << ")" << endl;
+        roiActive = TRUE;
+        break;
+    case EVENT_STOP:
+        cout << "Region stop (thread " << tid << ")" << endl;
+        roiActive = FALSE;
+        break;
+    default:
+        return;
+    }
+    PIN_RemoveInstrumentation();
+    if (ctxt)
+    {
+        PIN_ExecuteAt(ctxt);
+    }
+}
+
 /* ===================================================================== */
 /* Print Help Message                                                    */
 /* ===================================================================== */
@@ -535,21 +1446,27 @@ INT32 Usage()
 
 INT32 InitFile()
 {
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << KnobOutputFile.Value() << "_" << fileCounter << ".out";
-    OutFile.open(filePrefix.str().c_str());
-    OutFile.setf(ios::showbase);
-
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << axuliryFileName << "_" << fileCounter << ".out";
-    axuFile.open(filePrefix.str().c_str());
-    axuFile.setf(ios::showbase);
-
     howManyBranch = strtoull(KnobHowManyBranch.Value().c_str(), NULL, 0);
     howManySet = strtoull(KnobHowManySet.Value().c_str(), NULL, 0);
     offset_inst = strtoull(KnobOffset.Value().c_str(), NULL, 0);
+    bbvInterval = KnobBbv.Value();
+    shardBytes = KnobShardBytes.Value();
+    shardStep = shardBytes ? SHARD_GRAIN : KnobShardRecords.Value();
+#ifdef BRANCH_SIM
+    shardStep = 0;   // no trace
+#endif
+    init_cksum();
+    if (bbvInterval)
+    {
+        shardStep = 0;
+        // intervals start with the region
+        howManyBranch = -1;
+        offset_inst = 0;
+        bbvNext = bbvInterval;
+        bbvFile.open((KnobOutputFile.Value() + ".bb").c_str());
+    }
+
+    // the files of a thread are opened when it starts
     cout << "My offset " << offset_inst << endl;
 
     cout << KnobHowManyBranch.Value() << endl;
@@ -563,11 +1480,58 @@ int main(INT32 argc, CHAR **argv)
     PIN_InitSymbols();
 
     InitFile();
+#ifdef BRANCH_SIM
+    if (!init_simulation())
+    {
+        cerr << "Error: unknown predictor " << KnobPredictor.Value() << endl;
+        return 1;
+    }
+#endif
+
+    PIN_InitLock(&threadsLock);
+    PIN_InitLock(&bbvLock);
+    threadKey = PIN_CreateThreadDataKey(NULL);
+    threadReg = PIN_ClaimToolRegister();
+    if (threadKey == INVALID_TLS_KEY || !REG_valid(threadReg))
+    {
+        cerr << "Error: could not allocate the thread data" << endl;
+        return 1;
+    }
+
+    bufId = PIN_DefineTraceBuffer(sizeof(BRANCH_RECORD), NUM_BUF_PAGES, BufferFull, 0);
+    if (bufId == BUFFER_ID_INVALID)
+    {
+        cerr << "Error: could not allocate initial buffer" << endl;
+        return 1;
+    }
+
+    PIN_InitLock(&chunkLock);
+    PIN_SemaphoreInit(&chunkFree);
+    for (int i = 0; i < NUM_WRITE_CHUNKS; i++)
+    {
+        freeChunks.push_back(static_cast<BRANCH_RECORD *>(malloc(NUM_BUF_PAGES * 4096)));
+    }
+    for (int i = 0; i < NUM_WRITER_THREADS; i++)
+    {
+        PIN_SemaphoreInit(&writers[i].chunkReady);
+        writers[i].done = FALSE;
+        if (PIN_SpawnInternalThread(WriterThread, &writers[i], 0, &writers[i].uid) == INVALID_THREADID)
+        {
+            // write from the application threads instead
+            writers[i].done = TRUE;
+        }
+    }
+
+    control.RegisterHandler(RegionHandler, 0, TRUE);
+    control.Activate();
 
-    INS_AddInstrumentFunction(Instruction, 0);
+    TRACE_AddInstrumentFunction(Trace, 0);
     IMG_AddInstrumentFunction(ImageLoad, 0);
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    PIN_AddThreadFiniFunction(ThreadFini, 0);
 
     // Register Fini to be called when the application exits
+    PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
     PIN_AddFiniFunction(Fini, 0);
 
     PIN_StartProgram();
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Usage: gen_simpoints.sh <program> <trace name> [interval] [max clusters]
+#
+# Traces the representative regions of a program instead of all of it:
+# profiles basic block vectors every <interval> instructions, clusters
+# them (src/simpoint), traces the interval chosen for each cluster into
+# <trace name>_r<i>.bz2/.txt and lists them with their weights in
+# <trace name>.regions, for predictor --regions:<trace name>.regions
+BRANCH_EXT_ROOT=$(dirname $(realpath -s $0))
+INTERVAL=${3:-10000000}
+MAX_K=${4:-10}
+
+make -C ${BRANCH_EXT_ROOT}
+make -C ${BRANCH_EXT_ROOT}/../src simpoint
+
+${BRANCH_EXT_ROOT}/pin_tool/pin -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so -bbv ${INTERVAL} -o "$2" -- $1
+${BRANCH_EXT_ROOT}/../src/simpoint --k:${MAX_K} "$2.bb" > "$2.simpoints" || exit 1
+
+: > "$2.regions"
+while read interval weight; do
+    # the set ends the program once the interval is traced
+    ${BRANCH_EXT_ROOT}/pin_tool/pin -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so -compress 1 \
+        -skip $((interval * INTERVAL)) -f 0 -m ${INTERVAL} -b 1 -- $1
+    mv branches_0.out.bz2 "$2_r${interval}.bz2"
+    mv generalInfo_0.out "$2_r${interval}.txt"
+    echo "${weight} $(basename "$2")_r${interval}.bz2" >> "$2.regions"
+done < "$2.simpoints"
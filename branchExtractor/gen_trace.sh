@@ -3,11 +3,8 @@ BRANCH_EXT_ROOT=$(dirname $(realpath -s $0))
 
 make -C ${BRANCH_EXT_ROOT}
 
-${BRANCH_EXT_ROOT}/pin_tool/pin -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so -- $1
+# the trace is compressed by the tool while the program runs
+${BRANCH_EXT_ROOT}/pin_tool/pin -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so -compress 1 -- $1
 
-mv branches_0.out $2
-mv generalInfo_0.out "$2.txt"
-
-echo "bzip2 in progress - it may take a while"
-
-bzip2 -f $2
\ No newline at end of file
+mv branches_0.out.bz2 "$2.bz2"
+mv generalInfo_0.out "$2.txt"
\ No newline at end of file
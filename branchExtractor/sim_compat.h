@@ -0,0 +1,7 @@
+// Included ahead of the simulator sources (../src) built into the online
+// simulation tool: the Pin CRT headers define STATIC, which predictor.h
+// defines again for the static predictor
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#undef STATIC
@@ -0,0 +1,123 @@
+//========================================================//
+//  alias.cpp                                             //
+//  Source file for the aliasing/interference analyzer    //
+//                                                        //
+//  An aliased update is compared with the prediction of  //
+//  a private counter trained only by the same pair       //
+//========================================================//
+#include <stdio.h>
+#include "predictor.h"
+#include "alias.h"
+
+//------------------------------------//
+//        Alias Configuration         //
+//------------------------------------//
+int aliasAnalysis = 0;
+
+//------------------------------------//
+//       Alias Data Structures        //
+//------------------------------------//
+alias_table alias_tables[NUM_ALIAS_TABLES] = {
+    {"gshare"}, {"tourn global"}, {"tourn local"},
+    {"custom long"}, {"custom medium"}, {"custom short"}, {"custom local"}};
+
+// private counters: tag << 2 | 2-bit counter, 0 when empty
+uint32_t *alias_shadow;
+
+//------------------------------------//
+//          Alias Functions           //
+//------------------------------------//
+
+void init_alias(int table, uint32_t entries)
+{
+  if (!alias_shadow)
+  {
+    alias_shadow = (uint32_t *)calloc(1u << ALIAS_SHADOW_LOG, sizeof(uint32_t));
+  }
+  alias_tables[table].owner = (uint32_t *)calloc(entries, sizeof(uint32_t));
+}
+
+// 64-bit mix of a (table, PC, history) pair
+static inline uint64_t alias_hash(int table, uint32_t pc, uint64_t history)
+{
+  uint64_t h = ((uint64_t)table << 32 | pc) * 0x9e3779b97f4a7c15ull;
+  h ^= history * 0xc2b2ae3d27d4eb4full;
+  h ^= h >> 29;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 32;
+  return h;
+}
+
+void alias_update(int table, uint32_t index, uint32_t pc, uint64_t history, uint8_t counter, uint8_t outcome)
+{
+  alias_table *t = &alias_tables[table];
+  uint64_t h = alias_hash(table, pc, history);
+
+  // private counter of the pair, a cold (or evicted) pair starts at WN
+  uint32_t *slot = &alias_shadow[h & ((1u << ALIAS_SHADOW_LOG) - 1)];
+  uint32_t tag = (uint32_t)(h >> 34) | 1;
+  uint8_t private_counter = ((*slot >> 2) == tag) ? (*slot & 3) : WN;
+
+  uint32_t key = (uint32_t)(h >> 32) | 1;
+  t->updates++;
+  if (t->owner[index] && t->owner[index] != key)
+  {
+    t->aliased++;
+    int shared_right = (counter >= WT) == outcome;
+    int private_right = (private_counter >= WT) == outcome;
+    if (shared_right == private_right)
+    {
+      t->neutral++;
+    }
+    else if (shared_right)
+    {
+      t->constructive++;
+    }
+    else
+    {
+      t->destructive++;
+    }
+  }
+  t->owner[index] = key;
+
+  if (outcome == TAKEN && private_counter < ST)
+  {
+    private_counter++;
+  }
+  else if (outcome == NOTTAKEN && private_counter > SN)
+  {
+    private_counter--;
+  }
+  *slot = tag << 2 | private_counter;
+}
+
+void print_alias()
+{
+  printf("%-15s %10s %10s %12s %12s %10s %8s\n", "Alias table", "Updates", "Aliased",
+         "Constructive", "Destructive", "Neutral", "Net/Kbr");
+  for (int i = 0; i < NUM_ALIAS_TABLES; i++)
+  {
+    alias_table *t = &alias_tables[i];
+    if (!t->updates)
+    {
+      continue;
+    }
+    // extra mispredictions per 1000 updates caused by sharing entries
+    double net = 1000.0 * ((double)t->destructive - (double)t->constructive) / t->updates;
+    printf("%-15s %10llu %10llu %12llu %12llu %10llu %8.3f\n", t->name,
+           (unsigned long long)t->updates, (unsigned long long)t->aliased,
+           (unsigned long long)t->constructive, (unsigned long long)t->destructive,
+           (unsigned long long)t->neutral, net);
+  }
+}
+
+void cleanup_alias()
+{
+  for (int i = 0; i < NUM_ALIAS_TABLES; i++)
+  {
+    free(alias_tables[i].owner);
+    alias_tables[i].owner = NULL;
+  }
+  free(alias_shadow);
+  alias_shadow = NULL;
+}
@@ -0,0 +1,71 @@
+//========================================================//
+//  alias.h                                               //
+//  Header file for the aliasing/interference analyzer    //
+//                                                        //
+//  Shadows the untagged counter tables of gshare,        //
+//  tournament and custom to classify every update of an  //
+//  entry shared by different (PC, history) pairs         //
+//========================================================//
+
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Alias Defines             //
+//------------------------------------//
+
+// Analyzed tables (direction counters only: the choosers are trained on
+// which component was right, not on the branch outcome)
+#define ALIAS_GSHARE 0
+#define ALIAS_TOURNAMENT_GLOBAL 1
+#define ALIAS_TOURNAMENT_LOCAL 2
+#define ALIAS_CUSTOM_LONG 3
+#define ALIAS_CUSTOM_MEDIUM 4
+#define ALIAS_CUSTOM_SHORT 5
+#define ALIAS_CUSTOM_LOCAL 6
+#define NUM_ALIAS_TABLES 7
+
+// log2 entries of the shadow table of private counters, one per
+// (table, PC, history) pair, direct-mapped with a 30-bit tag
+#define ALIAS_SHADOW_LOG 22
+
+typedef struct
+{
+  const char *name;
+  uint32_t *owner;        // hash of the pair that last updated each entry
+  uint64_t updates;
+  uint64_t aliased;       // updates of an entry last updated by another pair
+  uint64_t constructive;  // aliased, shared counter right, private one wrong
+  uint64_t destructive;   // aliased, shared counter wrong, private one right
+  uint64_t neutral;       // aliased, both right or both wrong
+} alias_table;
+
+//------------------------------------//
+//        Alias Configuration         //
+//------------------------------------//
+extern int aliasAnalysis;      // Non-zero when the analyzer is enabled
+
+//------------------------------------//
+//      Alias Function Prototypes     //
+//------------------------------------//
+
+// Allocate the shadow state of 'table', which has 'entries' counters
+//
+void init_alias(int table, uint32_t entries);
+
+// Classify the update of counter 'index' of 'table' by the branch at
+// 'pc' whose index used 'history'. 'counter' is the value before the
+// update
+//
+void alias_update(int table, uint32_t index, uint32_t pc, uint64_t history, uint8_t counter, uint8_t outcome);
+
+// Print the interference of every table that was updated
+//
+void print_alias();
+
+void cleanup_alias();
+
+#endif
@@ -0,0 +1,253 @@
+//========================================================//
+//  bench.cpp                                             //
+//  Microbenchmarks for the predictor kernels             //
+//                                                        //
+//  Runs each engine's predict/train pair over in-memory  //
+//  branch records, without any trace I/O                 //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "predictor.h"
+
+#define BENCH_RECORDS (1 << 20)   // conditional branches per repetition
+#define BENCH_WARMUP 1            // untimed passes before measuring
+#define BENCH_REPS 10             // timed passes
+
+// A conditional branch, all the kernels need
+typedef struct
+{
+  uint32_t pc;
+  uint8_t outcome;
+} bench_record;
+
+// An engine under test. Add new predictors to the table below
+typedef struct
+{
+  const char *name;
+  int type;
+  void (*init)();
+  uint8_t (*predict)(uint32_t pc);
+  void (*train)(uint32_t pc, uint8_t outcome);
+  void (*cleanup)();
+} bench_engine;
+
+bench_engine engines[] = {
+    {"gshare", GSHARE, init_gshare, gshare_predict, train_gshare, cleanup_gshare},
+    {"tournament", TOURNAMENT, init_tournament, tournament_predict, train_tournament, cleanup_tournament},
+    {"custom", CUSTOM, init_tage, tage_predict, train_tage, cleanup_tage},
+    {"bimode", BIMODE, init_bimode, bimode_predict, train_bimode, cleanup_bimode},
+    {"yags", YAGS, init_yags, yags_predict, train_yags, cleanup_yags},
+};
+#define NUM_ENGINES (int)(sizeof(engines) / sizeof(engines[0]))
+
+volatile uint32_t bench_sink;   // keeps predictions from being optimized out
+
+static double now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Synthetic mix of loop branches (taken except on exit), branches that
+// repeat a short pattern and biased random branches over 4096 PCs
+//
+void make_synthetic(bench_record *records, int n)
+{
+  uint32_t seed = 0x9e3779b9;
+  uint32_t trip[4096] = {0};
+  for (int i = 0; i < n; i++)
+  {
+    uint32_t r = xorshift(&seed);
+    uint32_t site = r & 4095;
+    records[i].pc = 0x400000 + site * 16;
+    switch (site & 3)
+    {
+    case 0: // loop with a trip count of 8..15
+      trip[site]++;
+      records[i].outcome = (trip[site] % (8 + (site >> 2 & 7))) ? TAKEN : NOTTAKEN;
+      break;
+    case 1: // period-3 pattern
+      trip[site]++;
+      records[i].outcome = (trip[site] % 3 == 0) ? NOTTAKEN : TAKEN;
+      break;
+    default: // 90% biased random
+      records[i].outcome = ((xorshift(&seed) % 10) == 0) ? !(site & 4) : !!(site & 4);
+      break;
+    }
+  }
+}
+
+// Load the first n conditional branches of a text trace
+//
+// Returns the number of records loaded
+//
+int load_trace(const char *path, bench_record *records, int n)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    return 0;
+  }
+  char *line = NULL;
+  size_t len = 0;
+  int count = 0;
+  while (count < n && getline(&line, &len, f) != -1)
+  {
+    unsigned long long pc, target;
+    uint32_t outcome, condition;
+    if (sscanf(line, "0x%llx\t0x%llx\t%u\t%u", &pc, &target, &outcome, &condition) == 4 && condition)
+    {
+      records[count].pc = fold_address(pc);   // as make_prediction() does
+      records[count].outcome = outcome;
+      count++;
+    }
+  }
+  free(line);
+  fclose(f);
+  return count;
+}
+
+void run_engine(bench_engine *e, const char *input, bench_record *records, int n)
+{
+  double samples[BENCH_REPS];
+  uint32_t sink = 0;
+
+  bpType = e->type;
+  e->init();
+  for (int rep = -BENCH_WARMUP; rep < BENCH_REPS; rep++)
+  {
+    double start = now_ns();
+    for (int i = 0; i < n; i++)
+    {
+      sink += e->predict(records[i].pc);
+      e->train(records[i].pc, records[i].outcome);
+    }
+    double elapsed = now_ns() - start;
+    if (rep >= 0)
+    {
+      samples[rep] = elapsed / n;
+    }
+  }
+  e->cleanup();
+  bench_sink = sink;
+
+  double mean = 0, min = samples[0];
+  for (int rep = 0; rep < BENCH_REPS; rep++)
+  {
+    mean += samples[rep];
+    min = samples[rep] < min ? samples[rep] : min;
+  }
+  mean /= BENCH_REPS;
+  double var = 0;
+  for (int rep = 0; rep < BENCH_REPS; rep++)
+  {
+    var += (samples[rep] - mean) * (samples[rep] - mean);
+  }
+  double stddev = sqrt(var / (BENCH_REPS - 1));
+
+  printf("%-12s %-14s %9.2f %9.2f %9.2f %7.2f%%\n", e->name, input, mean, min, stddev, 100 * stddev / mean);
+}
+
+void usage()
+{
+  fprintf(stderr, "Usage: bench [<trace> ...] [--<engine> ...]\n");
+  fprintf(stderr, "       Times predict+train per conditional branch of each engine\n"
+                  "       on synthetic branches and on the first %d conditional\n"
+                  "       branches of each (uncompressed) trace\n", BENCH_RECORDS);
+  fprintf(stderr, "       engines:");
+  for (int j = 0; j < NUM_ENGINES; j++)
+  {
+    fprintf(stderr, " %s", engines[j].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "--help"))
+  {
+    usage();
+    return 0;
+  }
+
+  // engines to run, all unless some are named
+  int selected[NUM_ENGINES];
+  int any_selected = 0;
+  for (int j = 0; j < NUM_ENGINES; j++)
+  {
+    selected[j] = 0;
+  }
+  for (int i = 1; i < argc; i++)
+  {
+    if (strncmp(argv[i], "--", 2))
+    {
+      continue;
+    }
+    int j = 0;
+    while (j < NUM_ENGINES && strcmp(argv[i] + 2, engines[j].name))
+    {
+      j++;
+    }
+    if (j == NUM_ENGINES)
+    {
+      printf("Unrecognized option %s\n", argv[i]);
+      usage();
+      exit(1);
+    }
+    selected[j] = 1;
+    any_selected = 1;
+  }
+
+  bench_record *records = (bench_record *)malloc(BENCH_RECORDS * sizeof(bench_record));
+
+  printf("%-12s %-14s %9s %9s %9s %8s\n", "engine", "input", "ns/br", "min", "stddev", "cv");
+  for (int i = 0; i < argc; i++)
+  {
+    const char *input;
+    int n;
+    if (i == 0)
+    {
+      input = "synthetic";
+      make_synthetic(records, BENCH_RECORDS);
+      n = BENCH_RECORDS;
+    }
+    else if (strncmp(argv[i], "--", 2))
+    {
+      input = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+      n = load_trace(argv[i], records, BENCH_RECORDS);
+      if (n == 0)
+      {
+        fprintf(stderr, "Could not read branches from %s\n", argv[i]);
+        continue;
+      }
+    }
+    else
+    {
+      continue;
+    }
+
+    for (int j = 0; j < NUM_ENGINES; j++)
+    {
+      if (!any_selected || selected[j])
+      {
+        run_engine(&engines[j], input, records, n);
+      }
+    }
+  }
+
+  free(records);
+  return 0;
+}
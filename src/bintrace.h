@@ -0,0 +1,69 @@
+//========================================================//
+//  bintrace.h                                            //
+//  Binary branch trace format                            //
+//                                                        //
+//  Written by the extractor (-binary) and tracegen,      //
+//  read by the simulator. The layout is duplicated in    //
+//  branchExtractor/branchExt.cpp, keep both in sync      //
+//========================================================//
+
+#ifndef BINTRACE_H
+#define BINTRACE_H
+
+#include <stdint.h>
+
+//------------------------------------//
+//        Binary Trace Defines        //
+//------------------------------------//
+#define BT_MAGIC "BPTR"
+#define BT_VERSION 2    // written version, version 1 traces are still read
+
+// Record flags
+#define BT_TAKEN 0x01
+#define BT_COND 0x02
+#define BT_CALL 0x04
+#define BT_RET 0x08
+#define BT_DIRECT 0x10
+
+// File header, 32 bytes, little-endian. Text traces start with '0', so
+// the first byte tells the formats apart
+typedef struct
+{
+  char magic[4];          // BT_MAGIC
+  uint16_t version;       // BT_VERSION
+  uint8_t addr_bytes;     // width of pc and target: 4 (v1), 8 (v2)
+  uint8_t record_bytes;   // 2 * addr_bytes + 1 (v1), 0: variable (v2)
+  uint64_t offset;        // instructions skipped before tracing (-f)
+  int64_t limit;          // instructions per set (-m), -1 for all
+  uint32_t set;           // index of this set
+  uint32_t reserved;
+} bt_header;
+
+// A version 1 record is pc, target (4 bytes each, little-endian) and a
+// flags byte, packed without padding
+//
+// A version 2 record keeps full 64-bit addresses in about as little
+// space: the flags byte, then the pc as a difference to the pc of the
+// previous record (0 before the first one) and the target as a
+// difference to the pc, each zigzag-encoded as a LEB128 varint (one byte
+// for differences within +-63, at most 10 bytes)
+#define BT_MAX_DELTA 10
+#define BT_MAX_RECORD (1 + 2 * BT_MAX_DELTA)
+
+// Append the varint of 'delta' at 'p'
+//
+// Returns the end of the varint
+//
+static inline uint8_t *bt_put_delta(uint8_t *p, int64_t delta)
+{
+  uint64_t v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+  while (v >= 0x80)
+  {
+    *p++ = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+#endif
@@ -0,0 +1,359 @@
+//========================================================//
+//  ittage.cpp                                            //
+//  Source file for the Indirect Target Predictor         //
+//                                                        //
+//  A tagless base table indexed by PC backed by tagged   //
+//  tables indexed with geometrically increasing lengths  //
+//  of global/path history, in the style of ITTAGE        //
+//========================================================//
+#include <stdio.h>
+#include <math.h>
+#include "ittage.h"
+#include "predictor.h"
+
+//------------------------------------//
+//    Indirect Predictor Config       //
+//------------------------------------//
+int ittage = 0;
+int ittageNumTables = 6;    // tagged tables T1..T6
+int ittageLogEntries = 9;   // 512 entries per tagged table
+int ittageLogBase = 10;     // 1024 entries in the base table
+int ittageTagBits = 12;
+int ittageMinHist = 4;
+int ittageMaxHist = 256;
+
+//------------------------------------//
+//  Indirect Predictor Data Structures//
+//------------------------------------//
+
+// tagged table entry: target, 2-bit confidence, 1-bit useful
+typedef struct
+{
+  uint64_t target;
+  uint16_t tag;
+  uint8_t ctr;
+  uint8_t u;
+} ittage_entry;
+
+// base table entry: target, 2-bit confidence
+typedef struct
+{
+  uint64_t target;
+  uint8_t ctr;
+} ittage_base_entry;
+
+// history folded (compressed) down to 'clength' bits for hashing
+typedef struct
+{
+  uint32_t comp;
+  int clength;    // compressed length
+  int olength;    // original history length
+  int outpoint;   // where the bit leaving the window is folded back in
+} folded_history;
+
+ittage_base_entry *ittage_base;
+ittage_entry *ittage_table[ITTAGE_MAX_TABLES];
+int ittage_hist_len[ITTAGE_MAX_TABLES];
+
+uint8_t ittage_ghist[ITTAGE_HIST_BUF];  // one history bit per byte
+int ittage_ptr;                         // newest bit lives at ittage_ghist[ittage_ptr]
+uint32_t ittage_phist;                  // 16-bit path history of branch addresses
+folded_history ittage_fold_idx[ITTAGE_MAX_TABLES];
+folded_history ittage_fold_tag0[ITTAGE_MAX_TABLES];
+folded_history ittage_fold_tag1[ITTAGE_MAX_TABLES];
+
+uint32_t ittage_seed;   // LFSR for allocation decisions
+uint32_t ittage_tick;   // counts updates until the useful bits are aged
+
+// lookup state saved by ittage_predict() and consumed by train_ittage()
+uint32_t ittage_idx[ITTAGE_MAX_TABLES];
+uint16_t ittage_tag[ITTAGE_MAX_TABLES];
+int ittage_provider;      // longest hitting table (-1 if none)
+int ittage_alt;           // next longest hitting table (-1 if base)
+int ittage_use_alt;       // prediction taken from the alternate entry
+uint64_t ittage_alt_target;
+uint64_t ittage_pred_target;
+
+//------------------------------------//
+//   Indirect Predictor Functions     //
+//------------------------------------//
+
+static void fold_init(folded_history *f, int olength, int clength)
+{
+  f->comp = 0;
+  f->olength = olength;
+  f->clength = clength;
+  f->outpoint = olength % clength;
+}
+
+static void fold_update(folded_history *f)
+{
+  f->comp = (f->comp << 1) ^ ittage_ghist[ittage_ptr];
+  f->comp ^= ittage_ghist[(ittage_ptr + f->olength) & (ITTAGE_HIST_BUF - 1)] << f->outpoint;
+  f->comp ^= (f->comp >> f->clength);
+  f->comp &= (1 << f->clength) - 1;
+}
+
+static uint32_t ittage_random()
+{
+  // 32-bit xorshift, deterministic so runs are reproducible
+  ittage_seed ^= ittage_seed << 13;
+  ittage_seed ^= ittage_seed >> 17;
+  ittage_seed ^= ittage_seed << 5;
+  return ittage_seed;
+}
+
+void init_ittage()
+{
+  if (ittageNumTables > ITTAGE_MAX_TABLES)
+  {
+    ittageNumTables = ITTAGE_MAX_TABLES;
+  }
+  if (ittageMaxHist >= ITTAGE_HIST_BUF)
+  {
+    ittageMaxHist = ITTAGE_HIST_BUF - 1;
+  }
+
+  // base table
+  int base_entries = 1 << ittageLogBase;
+  ittage_base = (ittage_base_entry *)calloc(base_entries, sizeof(ittage_base_entry));
+  if (!ittage_base)
+  {
+    printf("Cannot allocate ITTAGE tables\n");
+    exit(1);
+  }
+
+  // tagged tables with geometric history lengths between min and max
+  int entries = 1 << ittageLogEntries;
+  for (int i = 0; i < ittageNumTables; i++)
+  {
+    ittage_table[i] = (ittage_entry *)calloc(entries, sizeof(ittage_entry));
+    if (!ittage_table[i])
+    {
+      printf("Cannot allocate ITTAGE tables\n");
+      exit(1);
+    }
+    if (ittageNumTables == 1)
+    {
+      ittage_hist_len[i] = ittageMinHist;
+    }
+    else
+    {
+      double ratio = pow((double)ittageMaxHist / ittageMinHist, (double)i / (ittageNumTables - 1));
+      ittage_hist_len[i] = (int)(ittageMinHist * ratio + 0.5);
+    }
+    fold_init(&ittage_fold_idx[i], ittage_hist_len[i], ittageLogEntries);
+    fold_init(&ittage_fold_tag0[i], ittage_hist_len[i], ittageTagBits);
+    fold_init(&ittage_fold_tag1[i], ittage_hist_len[i], ittageTagBits - 1);
+  }
+
+  for (int i = 0; i < ITTAGE_HIST_BUF; i++)
+  {
+    ittage_ghist[i] = 0;
+  }
+  ittage_ptr = 0;
+  ittage_phist = 0;
+  ittage_seed = 0x2545f491;
+  ittage_tick = 0;
+}
+
+uint64_t ittage_predict(uint64_t addr)
+{
+  uint32_t pc = fold_address(addr);
+  uint32_t entries_mask = (1 << ittageLogEntries) - 1;
+  uint32_t tag_mask = (1 << ittageTagBits) - 1;
+
+  // compute index and tag of every tagged table
+  for (int i = 0; i < ittageNumTables; i++)
+  {
+    int path_bits = ittage_hist_len[i] < 16 ? ittage_hist_len[i] : 16;
+    uint32_t path = ittage_phist & ((1 << path_bits) - 1);
+    ittage_idx[i] = (pc ^ (pc >> (i + 2)) ^ ittage_fold_idx[i].comp ^ path) & entries_mask;
+    ittage_tag[i] = (pc ^ ittage_fold_tag0[i].comp ^ (ittage_fold_tag1[i].comp << 1)) & tag_mask;
+  }
+
+  // find the longest (provider) and second longest (alternate) hit
+  ittage_provider = -1;
+  ittage_alt = -1;
+  for (int i = ittageNumTables - 1; i >= 0; i--)
+  {
+    if (ittage_table[i][ittage_idx[i]].tag == ittage_tag[i])
+    {
+      if (ittage_provider < 0)
+      {
+        ittage_provider = i;
+      }
+      else
+      {
+        ittage_alt = i;
+        break;
+      }
+    }
+  }
+
+  uint32_t base_index = pc & ((1 << ittageLogBase) - 1);
+  if (ittage_alt >= 0)
+  {
+    ittage_alt_target = ittage_table[ittage_alt][ittage_idx[ittage_alt]].target;
+  }
+  else
+  {
+    ittage_alt_target = ittage_base[base_index].target;
+  }
+
+  if (ittage_provider < 0)
+  {
+    ittage_use_alt = 1;
+    ittage_pred_target = ittage_alt_target;
+    return ittage_pred_target;
+  }
+
+  // a freshly allocated provider (zero confidence) defers to the alternate
+  ittage_entry *provider = &ittage_table[ittage_provider][ittage_idx[ittage_provider]];
+  ittage_use_alt = (provider->ctr == 0);
+  ittage_pred_target = ittage_use_alt ? ittage_alt_target : provider->target;
+  return ittage_pred_target;
+}
+
+static void update_target(uint64_t *entry_target, uint8_t *ctr, uint64_t target)
+{
+  if (*entry_target == target)
+  {
+    if (*ctr < 3)   // prevent 2-bit counter from going over upper bound
+    {
+      (*ctr)++;
+    }
+  }
+  else if (*ctr > 0)
+  {
+    (*ctr)--;
+  }
+  else   // out of confidence, replace the stored target
+  {
+    *entry_target = target;
+  }
+}
+
+static void update_tables(uint32_t pc, uint64_t target)
+{
+  uint32_t base_index = pc & ((1 << ittageLogBase) - 1);
+
+  if (ittage_provider >= 0)
+  {
+    ittage_entry *provider = &ittage_table[ittage_provider][ittage_idx[ittage_provider]];
+
+    // useful when the provider differs from the alternate and is right
+    if (provider->target != ittage_alt_target)
+    {
+      provider->u = (provider->target == target);
+    }
+
+    // the alternate is trained too whenever it supplied the prediction
+    if (ittage_use_alt)
+    {
+      if (ittage_alt >= 0)
+      {
+        ittage_entry *alt = &ittage_table[ittage_alt][ittage_idx[ittage_alt]];
+        update_target(&alt->target, &alt->ctr, target);
+      }
+      else
+      {
+        update_target(&ittage_base[base_index].target, &ittage_base[base_index].ctr, target);
+      }
+    }
+    update_target(&provider->target, &provider->ctr, target);
+  }
+  else
+  {
+    update_target(&ittage_base[base_index].target, &ittage_base[base_index].ctr, target);
+  }
+
+  // allocate an entry in a longer history table on a misprediction
+  if (ittage_pred_target != target && ittage_provider < ittageNumTables - 1)
+  {
+    int start = ittage_provider + 1;
+    if (start < ittageNumTables - 1 && (ittage_random() & 1))
+    {
+      start++;   // spread allocations over the longer tables
+    }
+
+    int allocated = 0;
+    for (int i = start; i < ittageNumTables; i++)
+    {
+      ittage_entry *e = &ittage_table[i][ittage_idx[i]];
+      if (e->u == 0)
+      {
+        e->tag = ittage_tag[i];
+        e->target = target;
+        e->ctr = 0;
+        allocated = 1;
+        break;
+      }
+    }
+
+    // no free entry, make room for a later allocation
+    if (!allocated)
+    {
+      for (int i = ittage_provider + 1; i < ittageNumTables; i++)
+      {
+        ittage_table[i][ittage_idx[i]].u = 0;
+      }
+    }
+  }
+
+  // periodically age all useful bits
+  ittage_tick++;
+  if ((ittage_tick & ((1 << 18) - 1)) == 0)
+  {
+    int entries = 1 << ittageLogEntries;
+    for (int i = 0; i < ittageNumTables; i++)
+    {
+      for (int j = 0; j < entries; j++)
+      {
+        ittage_table[i][j].u = 0;
+      }
+    }
+  }
+}
+
+static void push_history(uint8_t bit)
+{
+  ittage_ptr = (ittage_ptr - 1) & (ITTAGE_HIST_BUF - 1);
+  ittage_ghist[ittage_ptr] = bit;
+  for (int i = 0; i < ittageNumTables; i++)
+  {
+    fold_update(&ittage_fold_idx[i]);
+    fold_update(&ittage_fold_tag0[i]);
+    fold_update(&ittage_fold_tag1[i]);
+  }
+}
+
+void train_ittage(uint64_t addr, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t ret, uint32_t direct)
+{
+  uint32_t pc = fold_address(addr);
+  if (!direct && !ret)
+  {
+    update_tables(pc, target);
+  }
+
+  // conditional branches contribute their outcome, taken unconditional
+  // branches a bit of their target so indirect paths are distinguished
+  if (condition)
+  {
+    push_history(outcome);
+  }
+  else
+  {
+    push_history(((target >> 2) ^ (target >> 5)) & 1);
+  }
+  ittage_phist = ((ittage_phist << 1) ^ (pc >> 2)) & 0xffff;
+}
+
+void cleanup_ittage()
+{
+  free(ittage_base);
+  for (int i = 0; i < ittageNumTables; i++)
+  {
+    free(ittage_table[i]);
+  }
+}
@@ -0,0 +1,53 @@
+//========================================================//
+//  ittage.h                                              //
+//  Header file for the Indirect Target Predictor         //
+//                                                        //
+//  ITTAGE-style predictor for the targets of indirect    //
+//  jumps and calls (records with direct == 0)            //
+//========================================================//
+
+#ifndef ITTAGE_H
+#define ITTAGE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//     Indirect Predictor Defines     //
+//------------------------------------//
+#define ITTAGE_MAX_TABLES 12   // upper bound on tagged tables
+#define ITTAGE_HIST_BUF 4096   // circular global history buffer (bits)
+
+//------------------------------------//
+//    Indirect Predictor Config       //
+//------------------------------------//
+extern int ittage;             // Non-zero when the indirect predictor is enabled
+extern int ittageNumTables;    // Number of tagged tables
+extern int ittageLogEntries;   // log2 entries per tagged table
+extern int ittageLogBase;      // log2 entries of the tagless base table
+extern int ittageTagBits;      // Tag width of the tagged tables
+extern int ittageMinHist;      // Shortest history length (tagged table 1)
+extern int ittageMaxHist;      // Longest history length (last tagged table)
+
+//------------------------------------//
+//  Indirect Predictor Prototypes     //
+//------------------------------------//
+
+// Initialize the indirect target predictor
+//
+void init_ittage();
+
+// Predict the target of the indirect branch at PC 'pc'
+//
+uint64_t ittage_predict(uint64_t pc);
+
+// Train the indirect predictor with the last executed branch. The
+// tables are only updated for indirect non-return branches (which must
+// have been looked up with ittage_predict() right before); every branch
+// is shifted into the predictor's global/path history.
+//
+void train_ittage(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t ret, uint32_t direct);
+
+void cleanup_ittage();
+
+#endif
@@ -7,11 +7,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "predictor.h"
+#include "ittage.h"
+#include "ras.h"
+#include "stats.h"
+#include "profile.h"
+#include "perf.h"
+#include "results.h"
+#include "series.h"
+#include "alias.h"
+#include "traceinfo.h"
+#include "bintrace.h"
+#include "regions.h"
+#include "manifest.h"
 
 FILE *stream;
+pid_t stream_pid = 0;  // bunzip2 writing the stream, 0 if none
+int stream_binary = 0; // stream holds bt_header + binary records
+bt_header bin_header;
+uint8_t bin_record[BT_MAX_RECORD];
+uint64_t bin_pc = 0;   // last record of a version 2 trace, decoded by
+uint64_t bin_target = 0; // read_record()
+uint8_t bin_flags = 0;
 char *buf = NULL;
 size_t len = 0;
+uint64_t num_instructions = 0;
+const char *trace_name = "stdin";
+int current_shard = -1;        // shard of a manifest being read
+uint64_t shard_records = 0;    // records read from the current shard
+int shard_mismatches = 0;
+
+// Region of interest, in conditional branches of the trace: the first
+// roiStart are skipped, the next warmupBranches train the models
+// without being scored, and reading stops at roiEnd (0: end of trace)
+uint64_t roiStart = 0;
+uint64_t roiEnd = 0;
+uint64_t warmupBranches = 0;
 
 // Print out the Usage information to stderr
 //
@@ -19,14 +54,124 @@ void usage()
 {
   fprintf(stderr, "Usage: predictor <options> [<trace>]\n");
   fprintf(stderr, "       bunzip2 -kc trace.bz2 | predictor <options>\n");
+  fprintf(stderr, "       (a <trace> ending in .bz2 is decompressed through bunzip2,\n"
+                  "        text and binary traces are told apart automatically,\n"
+                  "        the shards of a <trace>.manifest are read in order)\n");
   fprintf(stderr, " Options:\n");
   fprintf(stderr, " --help       Print this message\n");
   fprintf(stderr, " --verbose    Print predictions on stdout\n");
+  fprintf(stderr, " --stats      Print simulator throughput, time per branch\n"
+                  "              and per record split by stage, peak RSS\n");
+  fprintf(stderr, " --perf       Count host cycles, instructions, cache and\n"
+                  "              branch misses of the simulator per model\n");
   fprintf(stderr, " --<type>     Branch prediction scheme:\n");
   fprintf(stderr, "    static\n"
                   "    gshare\n"
                   "    tournament\n"
-                  "    custom\n");
+                  "    custom\n"
+                  "    bimode\n"
+                  "    yags\n");
+  fprintf(stderr, " --hist:[<type>:]<mode>\n"
+                  "              Global history update mode of a predictor\n"
+                  "              (all when <type> is omitted):\n"
+                  "    cond      conditional outcomes only (default)\n"
+                  "    uncond    also shift in unconditional branches\n"
+                  "    path      XOR in a path history of target bits\n"
+                  "    both      uncond and path\n");
+  fprintf(stderr, " --path-bits:<n>\n"
+                  "              Target bits per taken branch in path history\n");
+  fprintf(stderr, " --delay:<n>  Train tables <n> conditional branches after\n"
+                  "              prediction (speculative history update)\n");
+  fprintf(stderr, " --alias      Classify aliased updates of the untagged\n"
+                  "              gshare/tournament/custom tables as\n"
+                  "              constructive, destructive or neutral\n");
+  fprintf(stderr, " --ittage[:<tables>[:<log2 entries>]]\n"
+                  "              Predict indirect jump/call targets\n"
+                  "              (1-%d tables, 1-20 log2 entries)\n", ITTAGE_MAX_TABLES);
+  fprintf(stderr, " --ras[:<depth>[:<overflow>[:<repair>]]]\n"
+                  "              Return address stack (default 16:wrap:none)\n"
+                  "              overflow: wrap, stall  repair: none, tos, top\n");
+  fprintf(stderr, " --ras-wrongpath:<ops>\n"
+                  "              Calls (c) and returns (r) replayed on the\n"
+                  "              RAS after each direction misprediction\n");
+  fprintf(stderr, " --warmup:<n> Train on <n> conditional branches before\n"
+                  "              scoring\n");
+  fprintf(stderr, " --roi:<start>[:<end>]\n"
+                  "              Skip to conditional branch <start> and stop\n"
+                  "              reading at <end>\n");
+  fprintf(stderr, " --insts:<n>  Instructions in the trace (for MPKI)\n");
+  fprintf(stderr, " --info:<file>\n"
+                  "              Trace sidecar with the instruction and branch\n"
+                  "              counts (default <trace>.txt, checked against\n"
+                  "              the records read, exit with 3 on a mismatch)\n");
+  fprintf(stderr, " --interval:<n>[:<file>]\n"
+                  "              Misprediction counts every <n> conditional\n"
+                  "              branches, CSV (binary if <file> ends in .bin)\n");
+  fprintf(stderr, " --json:<file>\n"
+                  "              Write the trace, configuration, results and\n"
+                  "              timing as JSON (- for stdout)\n");
+  fprintf(stderr, " --csv:<file> Append the same fields as a CSV row\n");
+  fprintf(stderr, " --compare:<file>\n"
+                  "              Compare with a --json baseline, exit with 2\n"
+                  "              on a regression\n");
+  fprintf(stderr, " --tolerance:<rate>\n"
+                  "              Allowed change of a misprediction rate\n"
+                  "              (per 1000, default 0.01)\n");
+  fprintf(stderr, " --max-slowdown:<pct>\n"
+                  "              Allowed throughput loss (default 10)\n");
+  fprintf(stderr, " --profile[:<n>]\n"
+                  "              Report the <n> conditional branches with the\n"
+                  "              most mispredictions (default 20)\n");
+  fprintf(stderr, " --regions:<file>\n"
+                  "              Simulate the '<weight> <trace>' regions of\n"
+                  "              <file> (gen_simpoints.sh) and combine their\n"
+                  "              results by weight\n");
+}
+
+// Parse a '[<type>:]<mode>' history option, applying the mode to one
+// predictor type or to all of them
+//
+// Returns True if Successful
+//
+int handle_hist_option(char *arg)
+{
+  int first = STATIC;
+  int last = YAGS;
+  char *mode = strchr(arg, ':');
+  if (mode)
+  {
+    int type;
+    for (type = STATIC; type <= YAGS; type++)
+    {
+      if (!strncasecmp(arg, bpName[type], mode - arg) && (int)strlen(bpName[type]) == mode - arg)
+      {
+        break;
+      }
+    }
+    if (type > YAGS)
+    {
+      return 0;
+    }
+    first = last = type;
+    mode++;
+  }
+  else
+  {
+    mode = arg;
+  }
+
+  for (int m = HIST_COND; m <= HIST_BOTH; m++)
+  {
+    if (!strcmp(mode, histModeName[m]))
+    {
+      for (int type = first; type <= last; type++)
+      {
+        histMode[type] = m;
+      }
+      return 1;
+    }
+  }
+  return 0;
 }
 
 // Process an option and update the predictor
@@ -52,6 +197,179 @@ int handle_option(char *arg)
   {
     bpType = CUSTOM;
   }
+  else if (!strncmp(arg, "--hist:", 7))
+  {
+    return handle_hist_option(arg + 7);
+  }
+  else if (!strncmp(arg, "--path-bits:", 12))
+  {
+    pathBits = atoi(arg + 12);
+    if (pathBits <= 0 || pathBits > 16)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--delay:", 8))
+  {
+    updateDelay = atoi(arg + 8);
+    if (updateDelay < 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--ittage") || !strncmp(arg, "--ittage:", 9))
+  {
+    ittage = 1;
+    sscanf(arg + 8, ":%d:%d", &ittageNumTables, &ittageLogEntries);
+    if (ittageNumTables < 1 || ittageNumTables > ITTAGE_MAX_TABLES ||
+        ittageLogEntries < 1 || ittageLogEntries > 20)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--ras-wrongpath:", 16))
+  {
+    rasWrongPath = arg + 16;
+  }
+  else if (!strcmp(arg, "--ras") || !strncmp(arg, "--ras:", 6))
+  {
+    rasDepth = 16;
+    char *opt = strchr(arg, ':');
+    if (opt)
+    {
+      rasDepth = atoi(opt + 1);
+      opt = strchr(opt + 1, ':');
+    }
+    if (opt)
+    {
+      opt++;
+      // the overflow policy is the whole field up to the repair policy
+      size_t len = strcspn(opt, ":");
+      if (len == 5 && !strncmp(opt, "stall", 5))
+      {
+        rasOverflow = RAS_STALL;
+      }
+      else if (len != 4 || strncmp(opt, "wrap", 4))
+      {
+        return 0;
+      }
+      opt = strchr(opt, ':');
+    }
+    if (opt)
+    {
+      opt++;
+      if (!strcmp(opt, "tos"))
+      {
+        rasRepair = RAS_REPAIR_TOS;
+      }
+      else if (!strcmp(opt, "top"))
+      {
+        rasRepair = RAS_REPAIR_TOP;
+      }
+      else if (strcmp(opt, "none"))
+      {
+        return 0;
+      }
+    }
+    if (rasDepth <= 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--insts:", 8))
+  {
+    num_instructions = strtoull(arg + 8, NULL, 0);
+  }
+  else if (!strncmp(arg, "--warmup:", 9))
+  {
+    warmupBranches = strtoull(arg + 9, NULL, 0);
+  }
+  else if (!strncmp(arg, "--roi:", 6))
+  {
+    char *end;
+    roiStart = strtoull(arg + 6, &end, 0);
+    if (*end == ':')
+    {
+      roiEnd = strtoull(end + 1, &end, 0);
+    }
+    if (*end || (roiEnd && roiEnd <= roiStart))
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--info:", 7))
+  {
+    traceInfoFile = arg + 7;
+  }
+  else if (!strncmp(arg, "--bimode", 8))
+  {
+    bpType = BIMODE;
+  }
+  else if (!strncmp(arg, "--yags", 6))
+  {
+    bpType = YAGS;
+  }
+  else if (!strcmp(arg, "--profile") || !strncmp(arg, "--profile:", 10))
+  {
+    profileTop = PROFILE_TOP_DEFAULT;
+    if (arg[9] == ':')
+    {
+      profileTop = atoi(arg + 10);
+    }
+    if (profileTop <= 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--stats"))
+  {
+    statsEnabled = 1;
+  }
+  else if (!strncmp(arg, "--interval:", 11))
+  {
+    seriesInterval = strtoul(arg + 11, NULL, 0);
+    char *file = strchr(arg + 11, ':');
+    if (file)
+    {
+      seriesFile = file + 1;
+    }
+    if (!seriesInterval)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--json:", 7))
+  {
+    resultsJson = arg + 7;
+  }
+  else if (!strncmp(arg, "--csv:", 6))
+  {
+    resultsCsv = arg + 6;
+  }
+  else if (!strncmp(arg, "--compare:", 10))
+  {
+    resultsBaseline = arg + 10;
+  }
+  else if (!strncmp(arg, "--tolerance:", 12))
+  {
+    compareTolerance = atof(arg + 12);
+  }
+  else if (!strncmp(arg, "--max-slowdown:", 15))
+  {
+    compareSlowdown = atof(arg + 15);
+  }
+  else if (!strcmp(arg, "--alias"))
+  {
+    aliasAnalysis = 1;
+  }
+  else if (!strcmp(arg, "--perf"))
+  {
+    perfEnabled = 1;
+  }
+  else if (!strncmp(arg, "--regions:", 10))
+  {
+    regionsFile = arg + 10;
+  }
   else if (!strcmp(arg, "--verbose"))
   {
     verbose = 1;
@@ -64,23 +382,248 @@ int handle_option(char *arg)
   return 1;
 }
 
-// Reads a line from the input stream and extracts the
-// PC and Outcome of a branch
+// Opens a trace file, through a bunzip2 child if it ends in .bz2. The
+// name is passed to bunzip2 as an argument, no shell parses it
 //
-// Returns True if Successful
+void open_file(const char *path)
+{
+  size_t n = strlen(path);
+  stream = NULL;
+  stream_pid = 0;
+  if (n <= 4 || strcmp(path + n - 4, ".bz2"))
+  {
+    stream = fopen(path, "r");
+    return;
+  }
+  int fd[2];
+  if (access(path, R_OK) || pipe(fd))
+  {
+    return;
+  }
+  stream_pid = fork();
+  if (stream_pid == 0)
+  {
+    dup2(fd[1], STDOUT_FILENO);
+    close(fd[0]);
+    close(fd[1]);
+    execlp("bunzip2", "bunzip2", "-c", "--", path, (char *)NULL);
+    perror("bunzip2");
+    _exit(127);
+  }
+  close(fd[1]);
+  if (stream_pid < 0)
+  {
+    stream_pid = 0;
+    close(fd[0]);
+    return;
+  }
+  stream = fdopen(fd[0], "r");
+}
+
+// Closes the trace file and waits for its bunzip2
+//
+// Returns True if the file read cleanly: a truncated or corrupt .bz2
+// only shows in the exit status of bunzip2
+//
+int close_stream()
+{
+  if (!stream)
+  {
+    return 1;
+  }
+  int ok = !ferror(stream);
+  fclose(stream);
+  stream = NULL;
+  if (stream_pid)
+  {
+    int status;
+    ok &= waitpid(stream_pid, &status, 0) == stream_pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    stream_pid = 0;
+  }
+  return ok;
+}
+
+// Opens a trace, or the first shard of a manifest
+//
+void open_stream(const char *path)
+{
+  trace_name = path;
+  if (!is_manifest(path))
+  {
+    open_file(path);
+    return;
+  }
+  stream = NULL;
+  if (load_manifest(path))
+  {
+    current_shard = 0;
+    open_file(shards[0].file);
+  }
+}
+
+// Detects a binary trace from its first byte and reads its header
 //
-int read_branch(uint32_t *pc, uint32_t *target, uint32_t *outcome, uint32_t *condition, uint32_t *call, uint32_t *ret, uint32_t *direct)
+// Returns True if the stream can be read
+//
+int open_trace()
 {
-  if (getline(&buf, &len, stream) == -1)
+  int c = getc(stream);
+  if (c == EOF)
+  {
+    return 1;   // empty trace
+  }
+  ungetc(c, stream);
+  if (c != BT_MAGIC[0])
+  {
+    return 1;
+  }
+  if (fread(&bin_header, sizeof(bin_header), 1, stream) != 1 || memcmp(bin_header.magic, BT_MAGIC, 4) ||
+      (!(bin_header.version == 1 && bin_header.addr_bytes == 4 && bin_header.record_bytes == 9) &&
+       !(bin_header.version == 2 && bin_header.addr_bytes == 8 && bin_header.record_bytes == 0)))
   {
+    fprintf(stderr, "Unsupported binary trace header\n");
     return 0;
   }
+  stream_binary = 1;
+  return 1;
+}
+
+// Reads a zigzag LEB128 difference of a version 2 record
+//
+// Returns True if Successful
+//
+static inline int read_delta(int64_t *delta)
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 7 * BT_MAX_DELTA; shift += 7)
+  {
+    int c = getc_unlocked(stream);
+    if (c == EOF)
+    {
+      return 0;
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+    {
+      *delta = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+      return 1;
+    }
+  }
+  return 0;
+}
 
-  sscanf(buf, "0x%x\t0x%x\t%d\t%d\t%d\t%d\t%d\n", pc, target, outcome, condition, call, ret, direct);
+// Reads a line (a record of a binary trace) from the current trace file
+//
+// Returns True if Successful
+//
+static inline int read_file_record()
+{
+  if (stream_binary && bin_header.version >= 2)
+  {
+    int c = getc_unlocked(stream);
+    int64_t pc_delta, target_delta;
+    if (c == EOF || !read_delta(&pc_delta) || !read_delta(&target_delta))
+    {
+      return 0;
+    }
+    bin_flags = c;
+    bin_pc += pc_delta;
+    bin_target = bin_pc + target_delta;
+    return 1;
+  }
+  if (stream_binary)
+  {
+    return fread(bin_record, bin_header.record_bytes, 1, stream) == 1;
+  }
+  return getline(&buf, &len, stream) != -1;
+}
 
+// Checks the record count of the shard just read and opens the next one
+//
+// Returns True if there was a next shard
+//
+int next_shard()
+{
+  if (shard_records != shards[current_shard].records)
+  {
+    printf("Shard mismatch: %s read %llu records, manifest %llu\n", shards[current_shard].file,
+           (unsigned long long)shard_records, (unsigned long long)shards[current_shard].records);
+    shard_mismatches++;
+  }
+  if (current_shard + 1 >= numShards)
+  {
+    return 0;
+  }
+  if (!close_stream())
+  {
+    printf("Cannot read shard %s\n", shards[current_shard].file);
+    exit(1);
+  }
+  open_file(shards[++current_shard].file);
+  shard_records = 0;
+  stream_binary = 0;
+  bin_pc = 0;
+  if (!stream || !open_trace())
+  {
+    printf("Cannot read shard %s\n", shards[current_shard].file);
+    exit(1);
+  }
   return 1;
 }
 
+// Reads the next record of the trace, moving on to the next shard at the
+// end of one
+//
+// Returns True if Successful
+//
+int read_record()
+{
+  while (!read_file_record())
+  {
+    if (current_shard < 0 || !next_shard())
+    {
+      return 0;
+    }
+  }
+  shard_records++;
+  return 1;
+}
+
+// Little-endian 32-bit field of a binary record
+static inline uint32_t bin_field(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Extracts the PC and Outcome of a branch from the line
+// read last
+//
+void decode_branch(uint64_t *pc, uint64_t *target, uint32_t *outcome, uint32_t *condition, uint32_t *call, uint32_t *ret, uint32_t *direct)
+{
+  if (stream_binary)
+  {
+    uint8_t flags = bin_flags;
+    if (bin_header.version == 1)
+    {
+      flags = bin_record[8];
+      *pc = bin_field(bin_record);
+      *target = bin_field(bin_record + 4);
+    }
+    else
+    {
+      *pc = bin_pc;
+      *target = bin_target;
+    }
+    *outcome = (flags & BT_TAKEN) != 0;
+    *condition = (flags & BT_COND) != 0;
+    *call = (flags & BT_CALL) != 0;
+    *ret = (flags & BT_RET) != 0;
+    *direct = (flags & BT_DIRECT) != 0;
+    return;
+  }
+  sscanf(buf, "0x%" SCNx64 "\t0x%" SCNx64 "\t%d\t%d\t%d\t%d\t%d\n", pc, target, outcome, condition, call, ret, direct);
+}
+
 int main(int argc, char *argv[])
 {
   // Set defaults
@@ -108,42 +651,231 @@ int main(int argc, char *argv[])
     else
     {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      open_stream(argv[i]);
+    }
+  }
+
+  // bimode and yags track the aliasing of their own tables
+  if (aliasAnalysis && (bpType == BIMODE || bpType == YAGS))
+  {
+    printf("--alias is not available for %s, it reports its own table statistics\n", bpName[bpType]);
+    usage();
+    exit(1);
+  }
+
+  // Each region runs the rest of main() in a child of its own
+  if (regionsFile)
+  {
+    open_stream(run_regions());
+  }
+
+  if (!stream || !open_trace())
+  {
+    printf("Cannot read trace %s\n", trace_name);
+    exit(1);
+  }
+
+  // Instruction and branch counts of the trace, from its sidecar
+  uint64_t info[NUM_INFO_COUNTS];
+  int have_info = (stream != stdin || traceInfoFile) && load_trace_info(trace_name, info);
+  if (have_info && !num_instructions)
+  {
+    num_instructions = info[INFO_INSTRUCTIONS];
+  }
+  if (!have_info && !num_instructions)
+  {
+    // a manifest without sidecar lists the instructions of every shard
+    for (int i = 0; i < numShards; i++)
+    {
+      num_instructions += shards[i].instructions;
     }
   }
 
   // Initialize the predictor
   init_predictor();
+  if (ittage)
+  {
+    init_ittage();
+  }
+  if (rasDepth)
+  {
+    init_ras();
+  }
+  if (profileTop)
+  {
+    init_profile();
+  }
+  if (seriesInterval)
+  {
+    init_series();
+  }
 
   uint32_t num_branches = 0;
   uint32_t mispredictions = 0;
-  uint32_t pc = 0;
-  uint32_t target = 0;
+  uint64_t pc = 0;
+  uint64_t target = 0;
   uint32_t outcome = NOTTAKEN;
   uint32_t condition = 0;
   uint32_t call = 0;
   uint32_t ret = 0;
   uint32_t direct = 0;
+  uint32_t num_indirect = 0;
+  uint32_t target_mispredictions = 0;
+  uint32_t num_returns = 0;
+  uint32_t return_mispredictions = 0;
+  uint32_t num_calls = 0;
+  uint32_t num_rets = 0;
+
+  uint64_t num_records = 0;
+  uint64_t num_conditional = 0;   // conditional branches read, scored or not
+  int stopped = 0;                // reading stopped at roiEnd
+
+  if (perfEnabled)
+  {
+    init_perf();
+  }
+  if (statsEnabled)
+  {
+    stats_begin();
+  }
+  results_begin();
 
   // Reach each branch from the trace
-  while (read_branch(&pc, &target, &outcome, &condition, &call, &ret, &direct))
+  while (1)
   {
+    STATS_RECORD_BEGIN();
+    PERF_RECORD_BEGIN();
+    if (!read_record())
+    {
+      break;
+    }
+    STATS_STAMP(STAGE_INPUT);
+    decode_branch(&pc, &target, &outcome, &condition, &call, &ret, &direct);
+    STATS_STAMP(STAGE_DECODE);
+    PERF_STAMP(PERF_INPUT);
+
+    // Skip records before the region and stop once it ends, scoring
+    // starts after the warmup
+    if (roiEnd && num_conditional >= roiEnd)
+    {
+      stopped = 1;
+      break;
+    }
+    num_records++;
+    num_calls += call;
+    num_rets += ret;
+    uint64_t branch_index = num_conditional;
+    num_conditional += condition;
+    if (branch_index < roiStart)
+    {
+      STATS_RECORD_CANCEL();
+      PERF_RECORD_END();
+      continue;
+    }
+    uint32_t scored = branch_index >= roiStart + warmupBranches;
+
     if (condition == 1)
     {
-      num_branches++;
+      PERF_BRANCH(PERF_DIRECTION);
+      num_branches += scored;
       // Make a prediction and compare with actual outcome
       uint32_t prediction = make_prediction(pc, target, direct);
       if (prediction != outcome)
       {
-        mispredictions++;
+        mispredictions += scored;
+        if (rasDepth)
+        {
+          ras_mispredict();
+        }
+      }
+      if (profileTop && scored)
+      {
+        profile_branch(pc, outcome, prediction != outcome);
       }
       if (verbose != 0)
       {
         printf("%d\n", prediction);
       }
     }
-    // Train the predictor
+    PERF_STAMP(PERF_DIRECTION);
+    // Predict the target of indirect jumps and calls
+    if (ittage && !direct && !ret)
+    {
+      PERF_BRANCH(PERF_INDIRECT);
+      num_indirect += scored;
+      if (ittage_predict(pc) != target)
+      {
+        target_mispredictions += scored;
+      }
+    }
+    if (ittage)
+    {
+      PERF_STAMP(PERF_INDIRECT);
+    }
+    // Predict return addresses from the RAS
+    if (rasDepth && ret)
+    {
+      PERF_BRANCH(PERF_RETURN);
+      num_returns += scored;
+      if (!ras_match(ras_predict(), target))
+      {
+        return_mispredictions += scored;
+      }
+    }
+    if (rasDepth)
+    {
+      PERF_STAMP(PERF_RETURN);
+    }
+    STATS_STAMP(STAGE_PREDICT);
+
+    // Train the predictors
+    if (ittage)
+    {
+      train_ittage(pc, target, outcome, condition, ret, direct);
+      PERF_STAMP(PERF_INDIRECT);
+    }
+    if (rasDepth)
+    {
+      train_ras(pc, call, ret);
+      PERF_STAMP(PERF_RETURN);
+    }
     train_predictor(pc, target, outcome, condition, call, ret, direct);
+    PERF_STAMP(PERF_DIRECTION);
+    STATS_STAMP(STAGE_TRAIN);
+    STATS_RECORD_END();
+    PERF_RECORD_END();
+
+    if (num_branches == series_next)
+    {
+      uint32_t totals[SERIES_COLUMNS] = {num_branches, mispredictions, num_indirect,
+                                         target_mispredictions, num_returns, return_mispredictions};
+      series_emit(totals);
+    }
+  }
+
+  // Reading stopped early closes the pipe under bunzip2, which then
+  // fails on its own
+  if (!close_stream() && !stopped)
+  {
+    printf("Cannot read trace %s\n", current_shard >= 0 ? shards[current_shard].file : trace_name);
+    exit(1);
+  }
+
+  run_results results;
+  results_end(&results);
+
+  // The instruction count covers the whole trace, scale it to the
+  // scored branches
+  if ((roiStart || roiEnd || warmupBranches) && num_instructions)
+  {
+    uint64_t total = have_info ? info[INFO_CONDITIONAL] : stopped ? 0 : num_conditional;
+    num_instructions = total ? num_instructions * num_branches / total : 0;
+  }
+  if (seriesInterval)
+  {
+    uint32_t totals[SERIES_COLUMNS] = {num_branches, mispredictions, num_indirect,
+                                       target_mispredictions, num_returns, return_mispredictions};
+    cleanup_series(totals);
   }
 
   // Print out the mispredict statistics
@@ -151,10 +883,99 @@ int main(int argc, char *argv[])
   printf("Incorrect:       %10d\n", mispredictions);
   float mispredict_rate = 1000 * ((float)mispredictions / (float)num_branches);
   printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  if (num_instructions)
+  {
+    printf("MPKI:            %10.3f\n", 1000 * ((double)mispredictions / (double)num_instructions));
+    printf("Branch Density:  %10.3f\n", 1000 * ((double)num_branches / (double)num_instructions));
+  }
+  print_predictor_stats();
+  if (aliasAnalysis)
+  {
+    print_alias();
+    cleanup_alias();
+  }
+  if (ittage)
+  {
+    printf("Indirect:        %10d\n", num_indirect);
+    printf("Target Incorrect:%10d\n", target_mispredictions);
+    float target_rate = 1000 * ((float)target_mispredictions / (float)num_indirect);
+    printf("Target Misprediction Rate: %7.3f\n", target_rate);
+    if (num_instructions)
+    {
+      printf("Target MPKI:     %10.3f\n", 1000 * ((double)target_mispredictions / (double)num_instructions));
+    }
+    cleanup_ittage();
+  }
+  if (rasDepth)
+  {
+    printf("Returns:         %10d\n", num_returns);
+    printf("Return Incorrect:%10d\n", return_mispredictions);
+    float return_rate = 1000 * ((float)return_mispredictions / (float)num_returns);
+    printf("Return Misprediction Rate: %7.3f\n", return_rate);
+    if (num_instructions)
+    {
+      printf("Return MPKI:     %10.3f\n", 1000 * ((double)return_mispredictions / (double)num_instructions));
+    }
+    printf("RAS %d:%s:%s Overflows: %u Underflows: %u\n", rasDepth,
+           rasOverflowName[rasOverflow], rasRepairName[rasRepair], ras_overflows, ras_underflows);
+    cleanup_ras();
+  }
+  if (profileTop)
+  {
+    print_profile(mispredictions);
+    cleanup_profile();
+  }
+  if (statsEnabled)
+  {
+    stats_end(num_records, num_branches);
+  }
+  if (perfEnabled)
+  {
+    print_perf(num_records);
+    cleanup_perf();
+  }
+
+  // Machine-readable results and baseline comparison
+  results.trace = trace_name;
+  results.records = num_records;
+  results.instructions = num_instructions;
+  results.branches = num_branches;
+  results.mispredictions = mispredictions;
+  results.indirect = num_indirect;
+  results.target_mispredictions = target_mispredictions;
+  results.returns = num_returns;
+  results.return_mispredictions = return_mispredictions;
+  if (resultsJson)
+  {
+    write_json(&results);
+  }
+  if (resultsCsv)
+  {
+    write_csv(&results);
+  }
+  int status = 0;
+  if (have_info && !stopped)
+  {
+    uint64_t read[NUM_INFO_COUNTS] = {num_instructions, num_records - num_conditional, num_conditional,
+                                      num_calls, num_rets};
+    if (check_trace_info(info, read))
+    {
+      status = 3;
+    }
+  }
+  if (shard_mismatches && !stopped)
+  {
+    status = 3;
+  }
+  if (resultsBaseline && compare_baseline(&results))
+  {
+    status = 2;
+  }
+  report_region(&results);
 
   // Cleanup
-  fclose(stream);
+  cleanup_manifest();
   free(buf);
 
-  return 0;
+  return status;
 }
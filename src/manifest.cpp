@@ -0,0 +1,87 @@
+//========================================================//
+//  manifest.cpp                                          //
+//  Source file for sharded trace manifests               //
+//                                                        //
+//  A manifest has a '# ...' header line, then one line   //
+//  per shard: file, first record, records, first         //
+//  instruction, instructions, cksum and bytes            //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include "manifest.h"
+
+//------------------------------------//
+//          Manifest State            //
+//------------------------------------//
+manifest_shard *shards = NULL;
+int numShards = 0;
+
+//------------------------------------//
+//        Manifest Functions          //
+//------------------------------------//
+
+int is_manifest(const char *path)
+{
+  size_t n = strlen(path);
+  return n > 9 && !strcmp(path + n - 9, ".manifest");
+}
+
+int load_manifest(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    return 0;
+  }
+  const char *slash = strrchr(path, '/');
+  int dirLen = slash ? (int)(slash - path + 1) : 0;
+
+  int capacity = 0;
+  char line[4096];
+  while (fgets(line, sizeof(line), f))
+  {
+    char name[4096];
+    unsigned long long first_record, records, first_instruction, instructions, bytes;
+    unsigned int cksum;
+    if (line[0] == '#' || sscanf(line, "%4095s %llu %llu %llu %llu %u %llu", name, &first_record, &records,
+                                 &first_instruction, &instructions, &cksum, &bytes) != 7)
+    {
+      continue;
+    }
+    if (numShards == capacity)
+    {
+      capacity = capacity ? 2 * capacity : 16;
+      shards = (manifest_shard *)realloc(shards, capacity * sizeof(manifest_shard));
+    }
+    manifest_shard *s = &shards[numShards++];
+    size_t size = dirLen + strlen(name) + 1;
+    s->file = (char *)malloc(size);
+    if (name[0] == '/')
+    {
+      snprintf(s->file, size, "%s", name);
+    }
+    else
+    {
+      snprintf(s->file, size, "%.*s%s", dirLen, path, name);
+    }
+    s->first_record = first_record;
+    s->records = records;
+    s->first_instruction = first_instruction;
+    s->instructions = instructions;
+    s->cksum = cksum;
+    s->bytes = bytes;
+  }
+  fclose(f);
+  return numShards;
+}
+
+void cleanup_manifest()
+{
+  for (int i = 0; i < numShards; i++)
+  {
+    free(shards[i].file);
+  }
+  free(shards);
+  shards = NULL;
+  numShards = 0;
+}
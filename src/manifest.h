@@ -0,0 +1,52 @@
+//========================================================//
+//  manifest.h                                            //
+//  Header file for sharded trace manifests               //
+//                                                        //
+//  The extractor splits long traces into shards listed   //
+//  in <name>.manifest (-shard_records/-shard_bytes),     //
+//  the simulator streams them in order                   //
+//========================================================//
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//      Manifest Data Structures      //
+//------------------------------------//
+
+// One line of a manifest: a shard and the part of the trace it holds
+typedef struct
+{
+  char *file;             // path, relative names are made relative to
+                          // the manifest
+  uint64_t first_record;
+  uint64_t records;
+  uint64_t first_instruction;
+  uint64_t instructions;
+  uint32_t cksum;         // POSIX cksum of the uncompressed shard
+  uint64_t bytes;         // size of the uncompressed shard
+} manifest_shard;
+
+extern manifest_shard *shards;
+extern int numShards;
+
+//------------------------------------//
+//    Manifest Function Prototypes    //
+//------------------------------------//
+
+// Returns True if 'path' names a manifest rather than a trace
+//
+int is_manifest(const char *path);
+
+// Read the shards of the manifest at 'path', in trace order
+//
+// Returns the number of shards (0 on error)
+//
+int load_manifest(const char *path);
+
+void cleanup_manifest();
+
+#endif
@@ -0,0 +1,266 @@
+//========================================================//
+//  perf.cpp                                              //
+//  Source file for the simulator self-profiling          //
+//                                                        //
+//  One perf_event group counting user-mode events of     //
+//  this process, read with a single system call          //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "perf.h"
+
+//------------------------------------//
+//          Perf State                //
+//------------------------------------//
+const char *perfEventName[NUM_PERF_EVENTS] = {"cycles", "instructions", "l1d-misses",
+                                              "llc-misses", "branch-misses"};
+const char *perfRegionName[NUM_PERF_REGIONS] = {"input", "direction", "indirect", "return"};
+
+int perfEnabled = 0;
+int perf_active = 0;
+int perf_sampling = 0;
+int perf_countdown = 1;   // measure the very first record
+
+int perf_fd[NUM_PERF_EVENTS];           // -1 if the event is missing
+int perf_leader = -1;                   // group leader fd
+int perf_slot[NUM_PERF_EVENTS];         // position in the group read, -1 if missing
+int perf_opened;                        // events in the group
+const char *perf_error = NULL;          // why no event could be opened
+
+uint64_t perf_last[NUM_PERF_EVENTS];    // counts at the previous stamp
+uint64_t perf_overhead[NUM_PERF_EVENTS];// counts of one read, removed from each stamp
+uint64_t perf_counts[NUM_PERF_REGIONS][NUM_PERF_EVENTS];
+uint64_t perf_hits[NUM_PERF_REGIONS];   // sampled records that entered the region
+uint64_t perf_branches[NUM_PERF_REGIONS];
+uint64_t perf_samples;
+uint64_t perf_start[NUM_PERF_EVENTS];   // run totals at init_perf
+
+//------------------------------------//
+//          Perf Functions            //
+//------------------------------------//
+
+#ifdef __linux__
+static int perf_open(uint32_t type, uint64_t config, int group)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;   // the read() system calls are not charged
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+#define PERF_CACHE_MISS(cache) \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+#endif
+
+// Read the group into 'counts', scaled up when the kernel had to
+// multiplex the counters. Missing events read as 0
+static void perf_read(uint64_t *counts)
+{
+  uint64_t data[3 + NUM_PERF_EVENTS];
+  memset(counts, 0, NUM_PERF_EVENTS * sizeof(uint64_t));
+  if (read(perf_leader, data, sizeof(data)) < (ssize_t)((3 + perf_opened) * sizeof(uint64_t)))
+  {
+    return;
+  }
+  double scale = (data[2] && data[2] < data[1]) ? (double)data[1] / data[2] : 1.0;
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    if (perf_slot[e] >= 0)
+    {
+      counts[e] = scale == 1.0 ? data[3 + perf_slot[e]] : (uint64_t)(data[3 + perf_slot[e]] * scale);
+    }
+  }
+}
+
+void init_perf()
+{
+  perf_opened = 0;
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    perf_slot[e] = -1;
+    perf_fd[e] = -1;
+  }
+
+#ifdef __linux__
+  uint32_t type[NUM_PERF_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                    PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+  uint64_t config[NUM_PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                      PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D),
+                                      PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL),
+                                      PERF_COUNT_HW_BRANCH_MISSES};
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    int fd = perf_open(type[e], config[e], perf_leader);
+    if (fd < 0)
+    {
+      perf_error = strerror(errno);
+      continue;
+    }
+    if (perf_leader < 0)
+    {
+      perf_leader = fd;
+    }
+    perf_fd[e] = fd;
+    perf_slot[e] = perf_opened++;
+  }
+#else
+  perf_error = "perf_event_open is Linux only";
+#endif
+
+  if (!perf_opened)
+  {
+    return;
+  }
+  perf_active = 1;
+
+  memset(perf_counts, 0, sizeof(perf_counts));
+  memset(perf_hits, 0, sizeof(perf_hits));
+  memset(perf_branches, 0, sizeof(perf_branches));
+  perf_samples = 0;
+
+  // counts of back-to-back reads, so they are not charged to the regions
+  uint64_t prev[NUM_PERF_EVENTS], cur[NUM_PERF_EVENTS];
+  perf_read(prev);
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    perf_overhead[e] = ~0ull;
+  }
+  for (int i = 0; i < 1000; i++)
+  {
+    perf_read(cur);
+    for (int e = 0; e < NUM_PERF_EVENTS; e++)
+    {
+      if (cur[e] - prev[e] < perf_overhead[e])
+      {
+        perf_overhead[e] = cur[e] - prev[e];
+      }
+      prev[e] = cur[e];
+    }
+  }
+
+  perf_read(perf_start);
+}
+
+void perf_begin_record()
+{
+  perf_sampling = 1;
+  perf_samples++;
+  perf_read(perf_last);
+}
+
+void perf_stamp(int region)
+{
+  uint64_t cur[NUM_PERF_EVENTS];
+  perf_read(cur);
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    uint64_t delta = cur[e] - perf_last[e];
+    perf_counts[region][e] += (delta > perf_overhead[e]) ? delta - perf_overhead[e] : 0;
+    perf_last[e] = cur[e];
+  }
+  perf_hits[region]++;
+}
+
+static void perf_print_header(const char *title)
+{
+  printf("%s:\n", title);
+  printf("  %-10s %6s", "region", "IPC");
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    printf(" %13s", perfEventName[e]);
+  }
+  printf("\n");
+}
+
+// Print one row: IPC, then each event per 'per' records
+static void perf_print_row(const char *name, uint64_t *counts, double per)
+{
+  printf("  %-10s", name);
+  if (perf_slot[PERF_CYCLES] >= 0 && perf_slot[PERF_INSTRUCTIONS] >= 0 && counts[PERF_CYCLES])
+  {
+    printf(" %6.2f", (double)counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES]);
+  }
+  else
+  {
+    printf(" %6s", "n/a");
+  }
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    if (perf_slot[e] >= 0)
+    {
+      printf(" %13.3f", counts[e] / per);
+    }
+    else
+    {
+      printf(" %13s", "n/a");
+    }
+  }
+  printf("\n");
+}
+
+void print_perf(uint64_t records)
+{
+  if (!perf_active)
+  {
+    printf("Perf counters unavailable: %s\n", perf_error ? perf_error : "not opened");
+    return;
+  }
+
+  uint64_t end[NUM_PERF_EVENTS];
+  perf_read(end);
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    end[e] -= perf_start[e];
+  }
+
+  perf_print_header("Perf per record");
+  if (records)
+  {
+    perf_print_row("run", end, records);
+  }
+  for (int r = 0; r < NUM_PERF_REGIONS; r++)
+  {
+    if (perf_hits[r])
+    {
+      perf_print_row(perfRegionName[r], perf_counts[r], perf_samples);
+    }
+  }
+
+  // each model also runs (trains) on the records it does not predict,
+  // their cost is spread over the ones it does
+  perf_print_header("Perf per predicted branch (conditional, indirect, return)");
+  for (int r = PERF_DIRECTION; r < NUM_PERF_REGIONS; r++)
+  {
+    if (perf_hits[r] && perf_branches[r])
+    {
+      perf_print_row(perfRegionName[r], perf_counts[r], perf_branches[r]);
+    }
+  }
+  if (perf_error)
+  {
+    printf("Perf events n/a: %s\n", perf_error);
+  }
+}
+
+void cleanup_perf()
+{
+  for (int e = 0; e < NUM_PERF_EVENTS; e++)
+  {
+    if (perf_fd[e] >= 0)
+    {
+      close(perf_fd[e]);
+    }
+  }
+}
@@ -0,0 +1,109 @@
+//========================================================//
+//  perf.h                                                //
+//  Header file for the simulator self-profiling          //
+//                                                        //
+//  Host hardware counters (perf_event_open) read around  //
+//  the predict/train code of each model on sampled       //
+//  records, and over the whole run                       //
+//========================================================//
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Perf Defines              //
+//------------------------------------//
+// Records between two measured records. Reading the counters is a
+// system call, so the period is much longer than STATS_SAMPLE_PERIOD
+// (and prime as well, so the two rarely sample the same record)
+#define PERF_SAMPLE_PERIOD 1021
+
+// Host events, each one is reported as n/a when it cannot be opened
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_L1D_MISSES 2
+#define PERF_LLC_MISSES 3
+#define PERF_BRANCH_MISSES 4
+#define NUM_PERF_EVENTS 5
+extern const char *perfEventName[];
+
+// Code regions of the simulation loop. Each model is charged for both
+// its prediction and its training
+#define PERF_INPUT 0       // reading and decoding the record
+#define PERF_DIRECTION 1   // conditional direction predictor (bpType)
+#define PERF_INDIRECT 2    // ITTAGE
+#define PERF_RETURN 3      // RAS
+#define NUM_PERF_REGIONS 4
+extern const char *perfRegionName[];
+
+//------------------------------------//
+//          Perf State                //
+//------------------------------------//
+extern int perfEnabled;        // --perf was given
+extern int perf_active;        // at least one counter could be opened
+extern int perf_sampling;      // the current record is being measured
+extern int perf_countdown;     // records until the next measured one
+extern uint64_t perf_branches[NUM_PERF_REGIONS];   // sampled records each region predicts
+
+// Start measuring the next record if it is a sampled one
+#define PERF_RECORD_BEGIN()                            \
+  do                                                   \
+  {                                                    \
+    if (perf_active && --perf_countdown == 0)          \
+    {                                                  \
+      perf_countdown = PERF_SAMPLE_PERIOD;             \
+      perf_begin_record();                             \
+    }                                                  \
+  } while (0)
+
+// Charge the counts since the previous stamp to 'region'
+#define PERF_STAMP(region)                             \
+  do                                                   \
+  {                                                    \
+    if (perf_sampling)                                 \
+    {                                                  \
+      perf_stamp(region);                              \
+    }                                                  \
+  } while (0)
+
+// The sampled record is one the region predicts: a conditional branch,
+// an indirect jump or call, a return
+#define PERF_BRANCH(region)                            \
+  do                                                   \
+  {                                                    \
+    if (perf_sampling)                                 \
+    {                                                  \
+      perf_branches[region]++;                         \
+    }                                                  \
+  } while (0)
+
+#define PERF_RECORD_END()                              \
+  do                                                   \
+  {                                                    \
+    perf_sampling = 0;                                 \
+  } while (0)
+
+//------------------------------------//
+//      Perf Function Prototypes      //
+//------------------------------------//
+
+// Open the counters. Missing events (no PMU, perf_event_paranoid,
+// seccomp) are dropped; when none is left the simulation runs
+// unmeasured and the report only gives the reason
+//
+void init_perf();
+
+void perf_begin_record();
+void perf_stamp(int region);
+
+// Print IPC and per-record counts of the run and of each region, then
+// the counts of each model per branch it predicts
+//
+void print_perf(uint64_t records);
+
+void cleanup_perf();
+
+#endif
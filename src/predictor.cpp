@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <math.h>
 #include "predictor.h"
+#include "alias.h"
 
 //
 // TODO:Student Information
@@ -21,8 +22,9 @@ const char *email = "dsanei@ucsd.edu";
 //------------------------------------//
 
 // Handy Global for use in output routines
-const char *bpName[4] = {"Static", "Gshare",
-                         "Tournament", "Custom"};
+const char *bpName[6] = {"Static", "Gshare",
+                         "Tournament", "Custom",
+                         "Bimode", "YAGS"};
 
 // define number of bits required for indexing the BHT here.
 int ghistoryBits = 15;    // Number of bits used for Global History (and Local History for tournament)
@@ -39,6 +41,19 @@ int shortTageBits = 14;    // short GHR for TAGE
 int tlhistoryBits = 10;   // local history table bits
 int chooserBits = 10;      // chooser table bits
 
+int bimodeBits = 15;      // GHR / index bits of each bi-mode direction table
+int bimodeChoiceBits = 14; // PC bits indexing the bi-mode choice table
+int yagsCacheBits = 13;   // GHR / index bits of each YAGS direction cache
+int yagsChoiceBits = 14;  // PC bits indexing the YAGS choice table
+int yagsTagBits = 8;      // PC bits stored as tag in the YAGS caches
+
+// history update mode of each predictor type (see HIST_* in predictor.h)
+const char *histModeName[4] = {"cond", "uncond", "path", "both"};
+int histMode[6] = {HIST_COND, HIST_COND, HIST_COND, HIST_COND, HIST_COND, HIST_COND};
+int pathBits = 2;         // target address bits shifted into path history per taken branch
+
+int updateDelay = 0;      // conditional branches in flight before their tables are trained
+
 //------------------------------------//
 //      Predictor Data Structures     //
 //------------------------------------//
@@ -46,6 +61,7 @@ int chooserBits = 10;      // chooser table bits
 // gshare
 uint8_t *bht_gshare;
 uint64_t ghistory;
+uint64_t phistory;      // path history (target address bits), see histMode
 
 // tournament predictor: global, local, chooser
 
@@ -53,6 +69,7 @@ uint64_t ghistory;
 uint8_t *bht_tglobal;   // global BHT (2-bit saturating counter for predictions)
 uint64_t tghistory;     // GHR: global history register (tracks last N global branch outcomes)
   // 8 bits (1 byte) are smallest addressable unit --> minimum bits
+uint64_t tphistory;     // path history register (tracks target bits of taken branches)
 
 // local predictor
 uint8_t *bht_tlocal;    // local BHT (2-bit saturating counter for local predictions)
@@ -64,6 +81,29 @@ uint16_t *lht;          // LHT: local history table (tracks history per branch)
 // chooser table
 uint8_t *chooser;       // chooser table to decide between global vs. local (2-bit saturating counter)
 
+// bi-mode: choice table picks one of two direction tables
+uint8_t *bimode_choice;   // PC-indexed 2-bit counters (>= WT selects the taken table)
+uint8_t *bimode_dir[2];   // [NOTTAKEN] not-taken biased, [TAKEN] taken biased
+uint64_t bghistory;
+uint64_t bphistory;
+uint32_t *bimode_owner[3]; // last PC to train each entry, for aliasing statistics
+bp_table_stats bimode_stats[3] = {{"choice"}, {"not-taken"}, {"taken"}};
+
+// YAGS: choice table plus tagged caches holding the exceptions to it
+uint8_t *yags_choice;     // PC-indexed 2-bit counters
+uint8_t *yags_ctr[2];     // [NOTTAKEN] not-taken exceptions of taken-biased branches
+                          // [TAKEN] taken exceptions of not-taken-biased branches
+uint16_t *yags_tag[2];
+uint64_t yghistory;
+uint64_t yphistory;
+uint32_t *yags_owner[3];
+bp_table_stats yags_stats[3] = {{"choice"}, {"NT cache"}, {"T cache"}};
+
+// delayed update: queue of in-flight conditional branches
+bp_inflight *inflight;
+int inflight_head;        // oldest in-flight branch
+int inflight_count;
+
 // custom predictor: adjusted tournament predictor, except GHR split into 3 different sizes
 
 // global predictor (short, medium, long GHR)
@@ -73,6 +113,7 @@ uint8_t *bht_tage_medium;   // 12-bit GHR
 uint64_t ghistory_medium;
 uint8_t *bht_tage_short;    // 8-bit GHR
 uint64_t ghistory_short;
+uint64_t phistory_tage;     // path history shared by the three global predictors
 
 // local predictor
 uint8_t *bht_local_tage;
@@ -115,6 +156,7 @@ void init_tage()
     bht_tage_short[i] = WN;
   }
   ghistory_short = 0;
+  phistory_tage = 0;
 
   // local predictor (BHT local)
   int local_bht_entries = 1 << tlhistoryBits;      // total entries (predictions per branch)
@@ -136,6 +178,14 @@ void init_tage()
   for ( int i = 0; i < chooser_entries; i++ ) {
     chooser_tage[i] = WN;  // each entry --> weakly not taken
   }
+
+  if (aliasAnalysis)
+  {
+    init_alias(ALIAS_CUSTOM_LONG, global_bht_entries_long);
+    init_alias(ALIAS_CUSTOM_MEDIUM, global_bht_entries_medium);
+    init_alias(ALIAS_CUSTOM_SHORT, global_bht_entries_short);
+    init_alias(ALIAS_CUSTOM_LOCAL, local_bht_entries);
+  }
 }
 
 uint8_t tage_predict(uint32_t pc)
@@ -144,19 +194,19 @@ uint8_t tage_predict(uint32_t pc)
   uint32_t long_bht_entries = 1 << longTageBits;                      // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_long = pc & (long_bht_entries - 1);          // extract lower bits of PC
   uint32_t long_lower_bits = ghistory_long & (long_bht_entries - 1);  // extract lower bits of GHR
-  uint32_t long_index = pc_lower_bits_long ^ long_lower_bits;         // XOR the PC, GHR to get global BHT index
+  uint32_t long_index = pc_lower_bits_long ^ long_lower_bits ^ (phistory_tage & (long_bht_entries - 1));         // XOR the PC, GHR, path to get global BHT index
 
   // medium global predictor
   uint32_t medium_bht_entries = 1 << mediumTageBits;                  // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_medium = pc & (medium_bht_entries - 1);      // extract lower bits of PC
   uint32_t medium_lower_bits = ghistory_medium & (medium_bht_entries - 1);   // extract lower bits of GHR
-  uint32_t medium_index = pc_lower_bits_medium ^ medium_lower_bits;   // XOR the PC, GHR to get global BHT index
+  uint32_t medium_index = pc_lower_bits_medium ^ medium_lower_bits ^ (phistory_tage & (medium_bht_entries - 1));   // XOR the PC, GHR, path to get global BHT index
 
   // short global predictor
   uint32_t short_bht_entries = 1 << shortTageBits;                    // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_short = pc & (short_bht_entries - 1);        // extract lower bits of PC
   uint32_t short_lower_bits = ghistory_short & (short_bht_entries - 1);     // extract lower bits of GHR
-  uint32_t short_index = pc_lower_bits_short ^ short_lower_bits;      // XOR the PC, GHR to get global BHT index
+  uint32_t short_index = pc_lower_bits_short ^ short_lower_bits ^ (phistory_tage & (short_bht_entries - 1));      // XOR the PC, GHR, path to get global BHT index
 
   // local predictor
   uint32_t local_lht_entries = 1 << pcIndexBits;                                // 2^pcIndexBits = LHT entries
@@ -214,25 +264,45 @@ uint8_t tage_predict(uint32_t pc)
   }
 }
 
+void update_tage_history(uint32_t pc, uint8_t outcome)
+{
+  // update LHT (left bitwise shift, then add new outcome)
+  uint32_t pc_lower_bits_local = pc & ((1 << pcIndexBits) - 1);
+  uint16_t old_lht = lht_tage[pc_lower_bits_local];
+  uint16_t new_lht = (old_lht << 1) | outcome;
+  lht_tage[pc_lower_bits_local] = new_lht & ((1 << tlhistoryBits) - 1);
+
+  // update long, mediun, short GHRs (left bitwise shift, then add new outcome)
+  uint64_t old_ghr_long = ghistory_long;
+  uint64_t new_ghr_long = (old_ghr_long << 1) | outcome;
+  ghistory_long = new_ghr_long & ((1 << longTageBits) - 1);
+  uint64_t old_ghr_medium = ghistory_medium;
+  uint64_t new_ghr_medium = (old_ghr_medium << 1) | outcome;
+  ghistory_medium = new_ghr_medium & ((1 << mediumTageBits) - 1);
+  uint64_t old_ghr_short = ghistory_short;
+  uint64_t new_ghr_short = (old_ghr_short << 1) | outcome;
+  ghistory_short = new_ghr_short & ((1 << shortTageBits) - 1);
+}
+
 void train_tage(uint32_t pc, uint8_t outcome)
 {
   // long global predictor
   uint32_t long_bht_entries = 1 << longTageBits;                      // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_long = pc & (long_bht_entries - 1);          // extract lower bits of PC
   uint32_t long_lower_bits = ghistory_long & (long_bht_entries - 1);       // extract lower bits of GHR
-  uint32_t long_index = pc_lower_bits_long ^ long_lower_bits;         // XOR the PC, GHR to get global BHT index
+  uint32_t long_index = pc_lower_bits_long ^ long_lower_bits ^ (phistory_tage & (long_bht_entries - 1));         // XOR the PC, GHR, path to get global BHT index
 
   // medium global predictor
   uint32_t medium_bht_entries = 1 << mediumTageBits;                  // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_medium = pc & (medium_bht_entries - 1);      // extract lower bits of PC
   uint32_t medium_lower_bits = ghistory_medium & (medium_bht_entries - 1);   // extract lower bits of GHR
-  uint32_t medium_index = pc_lower_bits_medium ^ medium_lower_bits;   // XOR the PC, GHR to get global BHT index
+  uint32_t medium_index = pc_lower_bits_medium ^ medium_lower_bits ^ (phistory_tage & (medium_bht_entries - 1));   // XOR the PC, GHR, path to get global BHT index
 
   // short global predictor
   uint32_t short_bht_entries = 1 << shortTageBits;                    // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_short = pc & (short_bht_entries - 1);        // extract lower bits of PC
   uint32_t short_lower_bits = ghistory_short & (short_bht_entries - 1);     // extract lower bits of GHR
-  uint32_t short_index = pc_lower_bits_short ^ short_lower_bits;      // XOR the PC, GHR to get global BHT index
+  uint32_t short_index = pc_lower_bits_short ^ short_lower_bits ^ (phistory_tage & (short_bht_entries - 1));      // XOR the PC, GHR, path to get global BHT index
 
   // local predictor
   uint32_t local_lht_entries = 1 << pcIndexBits;                                // 2^pcIndexBits = LHT entries
@@ -278,6 +348,20 @@ void train_tage(uint32_t pc, uint8_t outcome)
   uint32_t chooser_index = ghistory_short & (chooser_entries - 1);
   uint8_t chooser_prediction = chooser_tage[chooser_index];
 
+  if (aliasAnalysis)
+  {
+    uint64_t path_bits = phistory_tage & (long_bht_entries - 1);
+    alias_update(ALIAS_CUSTOM_LONG, long_index, pc, long_lower_bits | path_bits << 32,
+                 bht_tage_long[long_index], outcome);
+    alias_update(ALIAS_CUSTOM_MEDIUM, medium_index, pc,
+                 medium_lower_bits | (path_bits & (medium_bht_entries - 1)) << 32,
+                 bht_tage_medium[medium_index], outcome);
+    alias_update(ALIAS_CUSTOM_SHORT, short_index, pc,
+                 short_lower_bits | (path_bits & (short_bht_entries - 1)) << 32,
+                 bht_tage_short[short_index], outcome);
+    alias_update(ALIAS_CUSTOM_LOCAL, local_index, pc, local_index, bht_local_tage[local_index], outcome);
+  }
+
   // update predictors based on outcome
   if ( outcome == TAKEN ) {   // branch taken, checks to prevent 2-bit counter from going over upper bound
     if ( bht_tage_long[long_index] < ST ) {
@@ -335,21 +419,7 @@ void train_tage(uint32_t pc, uint8_t outcome)
     }
   }
 
-  // update LHT (left bitwise shift, then add new outcome)
-  uint16_t old_lht = lht_tage[pc_lower_bits_local];
-  uint16_t new_lht = (old_lht << 1) | outcome;
-  lht_tage[pc_lower_bits_local] = new_lht & ((1 << tlhistoryBits) - 1);
-
-  // update long, mediun, short GHRs (left bitwise shift, then add new outcome)
-  uint64_t old_ghr_long = ghistory_long;
-  uint64_t new_ghr_long = (old_ghr_long << 1) | outcome;
-  ghistory_long = new_ghr_long & ((1 << longTageBits) - 1);
-  uint64_t old_ghr_medium = ghistory_medium;
-  uint64_t new_ghr_medium = (old_ghr_medium << 1) | outcome;
-  ghistory_medium = new_ghr_medium & ((1 << mediumTageBits) - 1);
-  uint64_t old_ghr_short = ghistory_short;
-  uint64_t new_ghr_short = (old_ghr_short << 1) | outcome;
-  ghistory_short = new_ghr_short & ((1 << shortTageBits) - 1);
+  update_tage_history(pc, outcome);
 }
 
 void cleanup_tage()
@@ -372,6 +442,7 @@ void init_tournament()
     bht_tglobal[i] = WN;  // each entry --> weakly not taken
   }
   tghistory = 0;  // empty global history
+  tphistory = 0;  // empty path history
 
   // local predictor (BHT local)
   int local_bht_entries = 1 << lhistoryBits;      // total entries (predictions per branch)
@@ -393,6 +464,12 @@ void init_tournament()
   for ( int i = 0; i < chooser_entries; i++ ) {
     chooser[i] = WN;  // each entry --> weakly not taken
   }
+
+  if (aliasAnalysis)
+  {
+    init_alias(ALIAS_TOURNAMENT_GLOBAL, global_bht_entries);
+    init_alias(ALIAS_TOURNAMENT_LOCAL, local_bht_entries);
+  }
 }
 
 uint8_t tournament_predict(uint32_t pc)
@@ -400,8 +477,9 @@ uint8_t tournament_predict(uint32_t pc)
   // gshare predictor (similar to standalone gshare)
   uint32_t global_bht_entries = 1 << tghistoryBits;                      // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_global = pc & (global_bht_entries - 1);        // extract lower bits of PC
-  uint32_t ghistory_lower_bits = ghistory & (global_bht_entries - 1);   // extract lower bits of GHR
-  uint32_t global_index = pc_lower_bits_global ^ ghistory_lower_bits;   // XOR the PC, GHR to get global BHT index
+  uint32_t ghistory_lower_bits = tghistory & (global_bht_entries - 1);  // extract lower bits of GHR
+  uint32_t path_lower_bits = tphistory & (global_bht_entries - 1);      // extract lower bits of path history
+  uint32_t global_index = pc_lower_bits_global ^ ghistory_lower_bits ^ path_lower_bits;   // XOR the PC, GHR, path to get global BHT index
 
   // local predictor
   uint32_t local_lht_entries = 1 << pcIndexBits;                                // 2^pcIndexBits = LHT entries
@@ -438,13 +516,28 @@ uint8_t tournament_predict(uint32_t pc)
   }
 }
 
+void update_tournament_history(uint32_t pc, uint8_t outcome)
+{
+  // update LHT (left bitwise shift, then add new outcome)
+  uint32_t pc_lower_bits_local = pc & ((1 << pcIndexBits) - 1);
+  uint16_t old_lht = lht[pc_lower_bits_local];
+  uint16_t new_lht = (old_lht << 1) | outcome;
+  lht[pc_lower_bits_local] = new_lht & ((1 << lhistoryBits) - 1);
+
+  // update GHR (left bitwise shift, then add new outcome)
+  uint64_t old_ghr = tghistory;
+  uint64_t new_ghr = (old_ghr << 1) | outcome;
+  tghistory = new_ghr & ((1 << tghistoryBits) - 1);
+}
+
 void train_tournament(uint32_t pc, uint8_t outcome)
 {
   // gshare predictor (similar to standalone gshare)
   uint32_t global_bht_entries = 1 << tghistoryBits;                      // 2^ghistoryBits = global BHT entries
   uint32_t pc_lower_bits_global = pc & (global_bht_entries - 1);        // extract lower bits of PC
-  uint32_t ghistory_lower_bits = ghistory & (global_bht_entries - 1);   // extract lower bits of GHR
-  uint32_t global_index = pc_lower_bits_global ^ ghistory_lower_bits;   // XOR the PC, GHR to get global BHT index
+  uint32_t ghistory_lower_bits = tghistory & (global_bht_entries - 1);  // extract lower bits of GHR
+  uint32_t path_lower_bits = tphistory & (global_bht_entries - 1);      // extract lower bits of path history
+  uint32_t global_index = pc_lower_bits_global ^ ghistory_lower_bits ^ path_lower_bits;   // XOR the PC, GHR, path to get global BHT index
 
   // local predictor
   uint32_t local_lht_entries = 1 << pcIndexBits;                                // 2^pcIndexBits = LHT entries
@@ -472,6 +565,13 @@ void train_tournament(uint32_t pc, uint8_t outcome)
   // chooser index set to global index by default
   uint32_t chooser_index = global_index;
 
+  if (aliasAnalysis)
+  {
+    alias_update(ALIAS_TOURNAMENT_GLOBAL, global_index, pc,
+                 ghistory_lower_bits | (uint64_t)path_lower_bits << 32, bht_tglobal[global_index], outcome);
+    alias_update(ALIAS_TOURNAMENT_LOCAL, local_index, pc, local_index, bht_tlocal[local_index], outcome);
+  }
+
   // update global, local predictors based on actual outcome
   if ( outcome == TAKEN ) {   // branch taken
 
@@ -513,15 +613,7 @@ void train_tournament(uint32_t pc, uint8_t outcome)
     }
   }
 
-  // update LHT (left bitwise shift, then add new outcome)
-  uint16_t old_lht = lht[pc_lower_bits_local];
-  uint16_t new_lht = (old_lht << 1) | outcome;
-  lht[pc_lower_bits_local] = new_lht & ((1 << lhistoryBits) - 1);
-
-  // update GHR (left bitwise shift, then add new outcome)
-  uint64_t old_ghr = ghistory;
-  uint64_t new_ghr = (old_ghr << 1) | outcome;
-  ghistory = new_ghr & ((1 << tghistoryBits) - 1);
+  update_tournament_history(pc, outcome);
 }
 
 void cleanup_tournament()
@@ -545,6 +637,11 @@ void init_gshare()
     bht_gshare[i] = WN;   // initialize each BHT entry to weakly not taken
   }
   ghistory = 0;   // initialize empty global history
+  phistory = 0;   // initialize empty path history
+  if (aliasAnalysis)
+  {
+    init_alias(ALIAS_GSHARE, bht_entries);
+  }
 }
 
 uint8_t gshare_predict(uint32_t pc)
@@ -555,8 +652,10 @@ uint8_t gshare_predict(uint32_t pc)
   uint32_t pc_lower_bits = pc & (bht_entries - 1);
   // extract lower bits of global history register
   uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
+  // extract lower bits of path history register (zero unless enabled)
+  uint32_t phistory_lower_bits = phistory & (bht_entries - 1);
   // XOR lower bits of PC and GHR to get index of branch prediction
-  uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
+  uint32_t index = pc_lower_bits ^ ghistory_lower_bits ^ phistory_lower_bits;
   // get bht entry of index to retrieve branch prediction
   switch (bht_gshare[index])
   {
@@ -574,6 +673,13 @@ uint8_t gshare_predict(uint32_t pc)
   }
 }
 
+void update_gshare_history(uint8_t outcome)
+{
+  // Update history register
+  ghistory = ((ghistory << 1) | outcome);
+    // update with actual outcome for latest branch
+}
+
 void train_gshare(uint32_t pc, uint8_t outcome)
 {
   // get lower ghistoryBits of pc
@@ -582,8 +688,16 @@ void train_gshare(uint32_t pc, uint8_t outcome)
   uint32_t pc_lower_bits = pc & (bht_entries - 1);
   // extract lower bits of global history register
   uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
+  // extract lower bits of path history register (zero unless enabled)
+  uint32_t phistory_lower_bits = phistory & (bht_entries - 1);
   // XOR lower bits of PC and GHR to get index of branch prediction
-  uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
+  uint32_t index = pc_lower_bits ^ ghistory_lower_bits ^ phistory_lower_bits;
+
+  if (aliasAnalysis)
+  {
+    alias_update(ALIAS_GSHARE, index, pc, ghistory_lower_bits | (uint64_t)phistory_lower_bits << 32,
+                 bht_gshare[index], outcome);
+  }
 
   // Update state of entry in bht based on outcome
   switch (bht_gshare[index])
@@ -605,9 +719,7 @@ void train_gshare(uint32_t pc, uint8_t outcome)
     break;
   }
 
-  // Update history register
-  ghistory = ((ghistory << 1) | outcome);
-    // update with actual outcome for latest branch
+  update_gshare_history(outcome);
 }
 
 void cleanup_gshare()
@@ -615,8 +727,443 @@ void cleanup_gshare()
   free(bht_gshare);
 }
 
+// shared 2-bit saturating counter update
+static void update_counter(uint8_t *ctr, uint8_t outcome)
+{
+  if ( outcome == TAKEN ) {
+    if ( *ctr < ST ) {      // prevent 2-bit counter from going over upper bound
+      (*ctr)++;
+    }
+  } else {
+    if ( *ctr > SN ) {      // prevent 2-bit counter from going under lower bound
+      (*ctr)--;
+    }
+  }
+}
+
+// count an update of an entry last trained by another branch
+static void track_alias(bp_table_stats *stats, uint32_t *owner, uint32_t index, uint32_t pc)
+{
+  stats->accesses++;
+  if ( owner[index] != pc ) {
+    if ( owner[index] != 0 ) {
+      stats->aliased++;
+    }
+    owner[index] = pc;
+  }
+}
+
+// bi-mode functions
+void init_bimode()
+{
+  int choice_entries = 1 << bimodeChoiceBits;
+  int dir_entries = 1 << bimodeBits;
+  bimode_choice = (uint8_t *)malloc(choice_entries * sizeof(uint8_t));
+  for ( int i = 0; i < choice_entries; i++ ) {
+    bimode_choice[i] = WN;  // each entry --> weakly not taken
+  }
+  bimode_dir[NOTTAKEN] = (uint8_t *)malloc(dir_entries * sizeof(uint8_t));
+  bimode_dir[TAKEN] = (uint8_t *)malloc(dir_entries * sizeof(uint8_t));
+  for ( int i = 0; i < dir_entries; i++ ) {
+    bimode_dir[NOTTAKEN][i] = WN;   // biased towards its own direction
+    bimode_dir[TAKEN][i] = WT;
+  }
+  bimode_owner[0] = (uint32_t *)calloc(choice_entries, sizeof(uint32_t));
+  bimode_owner[1] = (uint32_t *)calloc(dir_entries, sizeof(uint32_t));
+  bimode_owner[2] = (uint32_t *)calloc(dir_entries, sizeof(uint32_t));
+  bghistory = 0;
+  bphistory = 0;
+}
+
+uint8_t bimode_predict(uint32_t pc)
+{
+  uint32_t choice_index = pc & ((1 << bimodeChoiceBits) - 1);                  // choice table is indexed by PC only
+  uint32_t dir_entries = 1 << bimodeBits;
+  uint32_t dir_index = (pc ^ bghistory ^ bphistory) & (dir_entries - 1);      // XOR the PC, GHR, path to get direction index
+
+  // the choice counter selects the direction table, which gives the prediction
+  uint8_t bias = (bimode_choice[choice_index] >= WT) ? TAKEN : NOTTAKEN;
+  return (bimode_dir[bias][dir_index] >= WT) ? TAKEN : NOTTAKEN;
+}
+
+void update_bimode_history(uint8_t outcome)
+{
+  bghistory = ((bghistory << 1) | outcome) & ((1 << bimodeBits) - 1);
+}
+
+void train_bimode(uint32_t pc, uint8_t outcome)
+{
+  uint32_t choice_index = pc & ((1 << bimodeChoiceBits) - 1);
+  uint32_t dir_entries = 1 << bimodeBits;
+  uint32_t dir_index = (pc ^ bghistory ^ bphistory) & (dir_entries - 1);
+
+  uint8_t bias = (bimode_choice[choice_index] >= WT) ? TAKEN : NOTTAKEN;
+  uint8_t prediction = (bimode_dir[bias][dir_index] >= WT) ? TAKEN : NOTTAKEN;
+
+  track_alias(&bimode_stats[0], bimode_owner[0], choice_index, pc);
+  track_alias(&bimode_stats[1 + bias], bimode_owner[1 + bias], dir_index, pc);
+
+  // only the selected direction table is trained
+  update_counter(&bimode_dir[bias][dir_index], outcome);
+
+  // the choice is left alone when it disagrees with the outcome but the
+  // selected direction table still predicted correctly
+  if ( !(bias != outcome && prediction == outcome) ) {
+    update_counter(&bimode_choice[choice_index], outcome);
+  }
+
+  update_bimode_history(outcome);
+}
+
+void cleanup_bimode()
+{
+  free(bimode_choice);
+  free(bimode_dir[NOTTAKEN]);
+  free(bimode_dir[TAKEN]);
+  for ( int i = 0; i < 3; i++ ) {
+    free(bimode_owner[i]);
+  }
+}
+
+// YAGS functions
+void init_yags()
+{
+  int choice_entries = 1 << yagsChoiceBits;
+  int cache_entries = 1 << yagsCacheBits;
+  yags_choice = (uint8_t *)malloc(choice_entries * sizeof(uint8_t));
+  for ( int i = 0; i < choice_entries; i++ ) {
+    yags_choice[i] = WN;  // each entry --> weakly not taken
+  }
+  for ( int d = NOTTAKEN; d <= TAKEN; d++ ) {
+    yags_ctr[d] = (uint8_t *)malloc(cache_entries * sizeof(uint8_t));
+    yags_tag[d] = (uint16_t *)malloc(cache_entries * sizeof(uint16_t));
+    for ( int i = 0; i < cache_entries; i++ ) {
+      yags_ctr[d][i] = (d == TAKEN) ? WT : WN;
+      yags_tag[d][i] = 0xffff;  // no valid tag fits in yagsTagBits
+    }
+  }
+  yags_owner[0] = (uint32_t *)calloc(choice_entries, sizeof(uint32_t));
+  yags_owner[1] = (uint32_t *)calloc(cache_entries, sizeof(uint32_t));
+  yags_owner[2] = (uint32_t *)calloc(cache_entries, sizeof(uint32_t));
+  yghistory = 0;
+  yphistory = 0;
+}
+
+uint8_t yags_predict(uint32_t pc)
+{
+  uint32_t choice_index = pc & ((1 << yagsChoiceBits) - 1);
+  uint32_t cache_index = (pc ^ yghistory ^ yphistory) & ((1 << yagsCacheBits) - 1);
+  uint16_t tag = pc & ((1 << yagsTagBits) - 1);
+
+  // a taken-biased branch looks for a not-taken exception and vice versa
+  uint8_t bias = (yags_choice[choice_index] >= WT) ? TAKEN : NOTTAKEN;
+  uint8_t cache = !bias;
+  if ( yags_tag[cache][cache_index] == tag ) {
+    return (yags_ctr[cache][cache_index] >= WT) ? TAKEN : NOTTAKEN;
+  }
+  return bias;
+}
+
+void update_yags_history(uint8_t outcome)
+{
+  yghistory = ((yghistory << 1) | outcome) & ((1 << yagsCacheBits) - 1);
+}
+
+void train_yags(uint32_t pc, uint8_t outcome)
+{
+  uint32_t choice_index = pc & ((1 << yagsChoiceBits) - 1);
+  uint32_t cache_index = (pc ^ yghistory ^ yphistory) & ((1 << yagsCacheBits) - 1);
+  uint16_t tag = pc & ((1 << yagsTagBits) - 1);
+
+  uint8_t bias = (yags_choice[choice_index] >= WT) ? TAKEN : NOTTAKEN;
+  uint8_t cache = !bias;
+  uint8_t hit = (yags_tag[cache][cache_index] == tag);
+  uint8_t prediction = hit ? ((yags_ctr[cache][cache_index] >= WT) ? TAKEN : NOTTAKEN) : bias;
+
+  track_alias(&yags_stats[0], yags_owner[0], choice_index, pc);
+
+  if ( hit ) {
+    // the exception cache entry is trained whenever it was consulted and hit
+    yags_stats[1 + cache].hits++;
+    track_alias(&yags_stats[1 + cache], yags_owner[1 + cache], cache_index, pc);
+    update_counter(&yags_ctr[cache][cache_index], outcome);
+  } else if ( outcome != bias ) {
+    // allocate an exception entry when the choice alone was wrong
+    yags_stats[1 + cache].accesses++;
+    yags_tag[cache][cache_index] = tag;
+    yags_ctr[cache][cache_index] = (outcome == TAKEN) ? WT : WN;
+    yags_owner[1 + cache][cache_index] = pc;
+  }
+
+  // the choice is left alone when it disagrees with the outcome but the
+  // exception cache still predicted correctly
+  if ( !(bias != outcome && prediction == outcome) ) {
+    update_counter(&yags_choice[choice_index], outcome);
+  }
+
+  update_yags_history(outcome);
+}
+
+void cleanup_yags()
+{
+  free(yags_choice);
+  for ( int d = NOTTAKEN; d <= TAKEN; d++ ) {
+    free(yags_ctr[d]);
+    free(yags_tag[d]);
+  }
+  for ( int i = 0; i < 3; i++ ) {
+    free(yags_owner[i]);
+  }
+}
+
+// print the per-table aliasing statistics of bi-mode and YAGS
+void print_predictor_stats()
+{
+  bp_table_stats *stats;
+  switch (bpType)
+  {
+  case BIMODE:
+    stats = bimode_stats;
+    break;
+  case YAGS:
+    stats = yags_stats;
+    break;
+  default:
+    return;
+  }
+
+  for ( int i = 0; i < 3; i++ ) {
+    float alias_rate = stats[i].accesses ? 1000 * ((float)stats[i].aliased / (float)stats[i].accesses) : 0;
+    printf("Table %-10s Updates: %10llu Aliased: %10llu (%7.3f)", stats[i].name,
+           (unsigned long long)stats[i].accesses, (unsigned long long)stats[i].aliased, alias_rate);
+    if (bpType == YAGS && i > 0) {
+      printf(" Hits: %10llu", (unsigned long long)stats[i].hits);
+    }
+    printf("\n");
+  }
+}
+
+// history update helpers
+
+// shift a (taken) unconditional branch into the GHR(s) of the predictor
+void update_uncond_history(uint32_t outcome)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    ghistory = ((ghistory << 1) | outcome);
+    break;
+  case TOURNAMENT:
+    tghistory = ((tghistory << 1) | outcome) & ((1 << tghistoryBits) - 1);
+    break;
+  case CUSTOM:
+    ghistory_long = ((ghistory_long << 1) | outcome) & ((1 << longTageBits) - 1);
+    ghistory_medium = ((ghistory_medium << 1) | outcome) & ((1 << mediumTageBits) - 1);
+    ghistory_short = ((ghistory_short << 1) | outcome) & ((1 << shortTageBits) - 1);
+    break;
+  case BIMODE:
+    bghistory = ((bghistory << 1) | outcome) & ((1 << bimodeBits) - 1);
+    break;
+  case YAGS:
+    yghistory = ((yghistory << 1) | outcome) & ((1 << yagsCacheBits) - 1);
+    break;
+  default:
+    break;
+  }
+}
+
+// shift the low target address bits into the path history register
+void update_path_history(uint64_t target)
+{
+  uint64_t path_bits = target & ((1 << pathBits) - 1);
+  switch (bpType)
+  {
+  case GSHARE:
+    phistory = (phistory << pathBits) | path_bits;
+    break;
+  case TOURNAMENT:
+    tphistory = (tphistory << pathBits) | path_bits;
+    break;
+  case CUSTOM:
+    phistory_tage = (phistory_tage << pathBits) | path_bits;
+    break;
+  case BIMODE:
+    bphistory = (bphistory << pathBits) | path_bits;
+    break;
+  case YAGS:
+    yphistory = (yphistory << pathBits) | path_bits;
+    break;
+  default:
+    break;
+  }
+}
+
+// shift a conditional outcome into the history of the predictor
+// without touching its tables
+void update_history(uint32_t pc, uint8_t outcome)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    update_gshare_history(outcome);
+    break;
+  case TOURNAMENT:
+    update_tournament_history(pc, outcome);
+    break;
+  case CUSTOM:
+    update_tage_history(pc, outcome);
+    break;
+  case BIMODE:
+    update_bimode_history(outcome);
+    break;
+  case YAGS:
+    update_yags_history(outcome);
+    break;
+  default:
+    break;
+  }
+}
+
+// copy the history registers (and the local history of 'pc') out of
+// the predictor, or back into it
+void save_history(uint32_t pc, bp_history *h)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    h->ghr[0] = ghistory;
+    h->phr = phistory;
+    break;
+  case TOURNAMENT:
+    h->ghr[0] = tghistory;
+    h->phr = tphistory;
+    h->lhr = lht[pc & ((1 << pcIndexBits) - 1)];
+    break;
+  case CUSTOM:
+    h->ghr[0] = ghistory_long;
+    h->ghr[1] = ghistory_medium;
+    h->ghr[2] = ghistory_short;
+    h->phr = phistory_tage;
+    h->lhr = lht_tage[pc & ((1 << pcIndexBits) - 1)];
+    break;
+  case BIMODE:
+    h->ghr[0] = bghistory;
+    h->phr = bphistory;
+    break;
+  case YAGS:
+    h->ghr[0] = yghistory;
+    h->phr = yphistory;
+    break;
+  default:
+    break;
+  }
+}
+
+void restore_history(uint32_t pc, bp_history *h)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    ghistory = h->ghr[0];
+    phistory = h->phr;
+    break;
+  case TOURNAMENT:
+    tghistory = h->ghr[0];
+    tphistory = h->phr;
+    lht[pc & ((1 << pcIndexBits) - 1)] = h->lhr;
+    break;
+  case CUSTOM:
+    ghistory_long = h->ghr[0];
+    ghistory_medium = h->ghr[1];
+    ghistory_short = h->ghr[2];
+    phistory_tage = h->phr;
+    lht_tage[pc & ((1 << pcIndexBits) - 1)] = h->lhr;
+    break;
+  case BIMODE:
+    bghistory = h->ghr[0];
+    bphistory = h->phr;
+    break;
+  case YAGS:
+    yghistory = h->ghr[0];
+    yphistory = h->phr;
+    break;
+  default:
+    break;
+  }
+}
+
+// delayed update: in-flight conditional branches wait in a circular
+// queue of updateDelay entries. History is updated speculatively when a
+// branch is predicted; its tables are trained once it leaves the queue
+void init_inflight()
+{
+  inflight = (bp_inflight *)malloc(updateDelay * sizeof(bp_inflight));
+  inflight_head = 0;
+  inflight_count = 0;
+}
+
+// resolve the oldest in-flight branch, training the tables with the
+// history it was predicted with
+void resolve_oldest()
+{
+  bp_inflight *e = &inflight[inflight_head];
+  bp_history spec;
+  save_history(e->pc, &spec);
+  restore_history(e->pc, &e->hist);
+  switch (bpType)
+  {
+  case GSHARE:
+    train_gshare(e->pc, e->outcome);
+    break;
+  case TOURNAMENT:
+    train_tournament(e->pc, e->outcome);
+    break;
+  case CUSTOM:
+    train_tage(e->pc, e->outcome);
+    break;
+  case BIMODE:
+    train_bimode(e->pc, e->outcome);
+    break;
+  case YAGS:
+    train_yags(e->pc, e->outcome);
+    break;
+  default:
+    break;
+  }
+  restore_history(e->pc, &spec);   // back to the speculative history
+  inflight_head = (inflight_head + 1) % updateDelay;
+  inflight_count--;
+}
+
+void train_delayed(uint32_t pc, uint8_t outcome)
+{
+  if (inflight_count == updateDelay)
+  {
+    resolve_oldest();
+  }
+  bp_inflight *e = &inflight[(inflight_head + inflight_count) % updateDelay];
+  e->pc = pc;
+  e->outcome = outcome;
+  save_history(pc, &e->hist);
+  inflight_count++;
+
+  // the trace only holds the correct path, so the speculative history
+  // is updated with the actual outcome (i.e. repaired immediately)
+  update_history(pc, outcome);
+}
+
+void cleanup_inflight()
+{
+  free(inflight);
+}
+
 void init_predictor()
 {
+  if (updateDelay && bpType != STATIC)
+  {
+    init_inflight();
+  }
+
   switch (bpType)
   {
   case STATIC:
@@ -630,6 +1177,12 @@ void init_predictor()
   case CUSTOM:
     init_tage();
     break;
+  case BIMODE:
+    init_bimode();
+    break;
+  case YAGS:
+    init_yags();
+    break;
   default:
     break;
   }
@@ -639,8 +1192,9 @@ void init_predictor()
 // Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
 // indicates a prediction of not taken
 //
-uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
+uint32_t make_prediction(uint64_t addr, uint64_t target, uint32_t direct)
 {
+  uint32_t pc = fold_address(addr);
 
   // Make a prediction based on the bpType
   switch (bpType)
@@ -653,6 +1207,10 @@ uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
     return tournament_predict(pc);
   case CUSTOM:
     return tage_predict(pc);
+  case BIMODE:
+    return bimode_predict(pc);
+  case YAGS:
+    return yags_predict(pc);
   default:
     break;
   }
@@ -666,22 +1224,47 @@ uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
 // indicates that the branch was not taken)
 //
 
-void train_predictor(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+void train_predictor(uint64_t addr, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
 {
-  if (condition)
+  uint32_t pc = fold_address(addr);
+  if (condition && updateDelay && bpType != STATIC)
+  {
+    train_delayed(pc, outcome);
+  }
+  else if (condition)
   {
     switch (bpType)
     {
     case STATIC:
       return;
     case GSHARE:
-      return train_gshare(pc, outcome);
+      train_gshare(pc, outcome);
+      break;
     case TOURNAMENT:
-      return train_tournament(pc, outcome);
+      train_tournament(pc, outcome);
+      break;
     case CUSTOM:
-      return train_tage(pc, outcome);
+      train_tage(pc, outcome);
+      break;
+    case BIMODE:
+      train_bimode(pc, outcome);
+      break;
+    case YAGS:
+      train_yags(pc, outcome);
+      break;
     default:
       break;
     }
   }
+  else if (histMode[bpType] & HIST_UNCOND)
+  {
+    update_uncond_history(outcome);
+  }
+
+  // path history only advances on taken branches, after the tables
+  // above were trained with the history they were predicted with
+  if ((histMode[bpType] & HIST_PATH) && outcome == TAKEN)
+  {
+    update_path_history(target);
+  }
 }
\ No newline at end of file
@@ -30,6 +30,8 @@ extern const char *email;
 #define GSHARE 1
 #define TOURNAMENT 2
 #define CUSTOM 3
+#define BIMODE 4
+#define YAGS 5
 extern const char *bpName[];
 
 // Definitions for 2-bit counters
@@ -59,17 +61,116 @@ void init_predictor();
 // Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
 // indicates a prediction of not taken
 //
-uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct);
+uint32_t make_prediction(uint64_t pc, uint64_t target, uint32_t direct);
 
 // Train the predictor the last executed branch at PC 'pc' and with
 // outcome 'outcome' (true indicates that the branch was taken, false
 // indicates that the branch was not taken)
 //
-void train_predictor(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+void train_predictor(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
 
 // Please add your code below, and DO NOT MODIFY ANY OF THE CODE ABOVE
 // 
 
+// Branch addresses are 64-bit. The tables are indexed with the address
+// folded to 32 bits, so the high bits (shared libraries, ASLR) select
+// entries too; addresses below 4GB are used as they are
+//
+static inline uint32_t fold_address(uint64_t addr)
+{
+  return (uint32_t)addr ^ (uint32_t)(addr >> 32);
+}
+
+// History update modes, configurable per predictor type. By default
+// only conditional outcomes are shifted into the global history
+//
+#define HIST_COND 0    // conditional branch outcomes only
+#define HIST_UNCOND 1  // also shift unconditional branches into the GHR
+#define HIST_PATH 2    // XOR a path history of target bits into the index
+#define HIST_BOTH (HIST_UNCOND | HIST_PATH)
+extern const char *histModeName[];
+extern int histMode[];   // indexed by bpType
+extern int pathBits;     // target bits shifted into path history per branch
+
+void update_uncond_history(uint32_t outcome);
+void update_path_history(uint64_t target);
+
+// Predictor engines behind make_prediction() and train_predictor(),
+// also driven directly by the microbenchmarks in bench.cpp
+//
+void init_gshare();
+uint8_t gshare_predict(uint32_t pc);
+void train_gshare(uint32_t pc, uint8_t outcome);
+void cleanup_gshare();
+
+void init_tournament();
+uint8_t tournament_predict(uint32_t pc);
+void train_tournament(uint32_t pc, uint8_t outcome);
+void cleanup_tournament();
+
+void init_tage();
+uint8_t tage_predict(uint32_t pc);
+void train_tage(uint32_t pc, uint8_t outcome);
+void cleanup_tage();
+
+void init_bimode();
+uint8_t bimode_predict(uint32_t pc);
+void train_bimode(uint32_t pc, uint8_t outcome);
+void cleanup_bimode();
+
+void init_yags();
+uint8_t yags_predict(uint32_t pc);
+void train_yags(uint32_t pc, uint8_t outcome);
+void cleanup_yags();
+
+// Bi-mode and YAGS configuration
+//
+extern int bimodeBits;       // index bits of each bi-mode direction table
+extern int bimodeChoiceBits; // index bits of the bi-mode choice table
+extern int yagsCacheBits;    // index bits of each YAGS exception cache
+extern int yagsChoiceBits;   // index bits of the YAGS choice table
+extern int yagsTagBits;      // tag bits of the YAGS exception caches
+
+// Aliasing statistics of one predictor table
+typedef struct
+{
+  const char *name;
+  uint64_t accesses;   // updates (allocations included for tagged tables)
+  uint64_t aliased;    // updates of an entry last trained by another PC
+  uint64_t hits;       // tag hits (tagged tables only)
+} bp_table_stats;
+
+// Print per-table statistics of the predictor, if it keeps any
+//
+void print_predictor_stats();
+
+// Delayed update pipeline model. With updateDelay > 0, up to that many
+// conditional branches are in flight: each is predicted with tables
+// that have not yet seen the older in-flight branches, its history is
+// updated speculatively at prediction time and its table update is
+// applied when it resolves (leaves the queue)
+//
+extern int updateDelay;
+
+// Snapshot of the history a branch was predicted with
+typedef struct
+{
+  uint64_t ghr[3];   // global history register(s)
+  uint64_t phr;      // path history register
+  uint16_t lhr;      // local history of the branch
+} bp_history;
+
+typedef struct
+{
+  uint32_t pc;
+  uint8_t outcome;
+  bp_history hist;
+} bp_inflight;
+
+void update_history(uint32_t pc, uint8_t outcome);
+void save_history(uint32_t pc, bp_history *h);
+void restore_history(uint32_t pc, bp_history *h);
+
 
 
 #endif
@@ -0,0 +1,138 @@
+//========================================================//
+//  profile.cpp                                           //
+//  Source file for the per-PC misprediction profiler     //
+//                                                        //
+//  Open-addressing (linear probing) table keyed by PC,   //
+//  doubled when half full, sorted once at the end        //
+//========================================================//
+#include <stdio.h>
+#include "profile.h"
+
+//------------------------------------//
+//        Profile Configuration       //
+//------------------------------------//
+int profileTop = 0;
+
+//------------------------------------//
+//      Profile Data Structures       //
+//------------------------------------//
+profile_entry *profile_table;
+uint32_t profile_log;    // log2 slots
+uint32_t profile_mask;   // slots - 1
+uint32_t profile_used;   // occupied slots
+
+//------------------------------------//
+//         Profile Functions          //
+//------------------------------------//
+
+// Fibonacci hashing of the PC folded to 32 bits: the top bits of the
+// product mix all PC bits, so branches a fixed stride apart do not cluster
+static inline uint32_t profile_hash(uint64_t pc)
+{
+  return (uint32_t)((uint32_t)(pc ^ (pc >> 32)) * 2654435769u) >> (32 - profile_log);
+}
+
+static void profile_alloc(uint32_t log)
+{
+  profile_log = log;
+  profile_mask = (1u << log) - 1;
+  profile_table = (profile_entry *)calloc(1u << log, sizeof(profile_entry));
+}
+
+void init_profile()
+{
+  profile_alloc(PROFILE_INIT_LOG);
+  profile_used = 0;
+}
+
+static profile_entry *profile_slot(uint64_t pc)
+{
+  uint32_t i = profile_hash(pc);
+  while (profile_table[i].execs && profile_table[i].pc != pc)
+  {
+    i = (i + 1) & profile_mask;
+  }
+  return &profile_table[i];
+}
+
+// Double the table and reinsert every branch
+static void profile_grow()
+{
+  profile_entry *old = profile_table;
+  uint32_t slots = profile_mask + 1;
+  profile_alloc(profile_log + 1);
+  for (uint32_t i = 0; i < slots; i++)
+  {
+    if (old[i].execs)
+    {
+      *profile_slot(old[i].pc) = old[i];
+    }
+  }
+  free(old);
+}
+
+void profile_branch(uint64_t pc, uint32_t outcome, uint32_t mispredicted)
+{
+  profile_entry *e = profile_slot(pc);
+  if (!e->execs)
+  {
+    if (2 * (profile_used + 1) > profile_mask + 1)
+    {
+      profile_grow();
+      e = profile_slot(pc);
+    }
+    profile_used++;
+    e->pc = pc;
+    e->last = outcome;
+  }
+  e->execs++;
+  e->mispredictions += mispredicted;
+  e->taken += outcome;
+  e->transitions += e->last != outcome;
+  e->last = outcome;
+}
+
+// Most mispredictions first, ties broken by PC for a stable report
+static int profile_compare(const void *a, const void *b)
+{
+  const profile_entry *x = (const profile_entry *)a;
+  const profile_entry *y = (const profile_entry *)b;
+  if (x->mispredictions != y->mispredictions)
+  {
+    return x->mispredictions < y->mispredictions ? 1 : -1;
+  }
+  return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+void print_profile(uint32_t mispredictions)
+{
+  // compact the occupied slots to the front, the table is not probed again
+  uint32_t n = 0;
+  for (uint32_t i = 0; i <= profile_mask; i++)
+  {
+    if (profile_table[i].execs)
+    {
+      profile_table[n++] = profile_table[i];
+    }
+  }
+  qsort(profile_table, n, sizeof(profile_entry), profile_compare);
+
+  printf("Static Branches: %10u\n", n);
+  printf("%4s %10s %10s %10s %8s %7s %7s %7s %7s\n", "Rank", "PC", "Execs", "Incorrect",
+         "Rate", "Taken%", "Trans%", "Share%", "Cumul%");
+  double cumulative = 0;
+  for (uint32_t i = 0; i < n && i < (uint32_t)profileTop; i++)
+  {
+    profile_entry *e = &profile_table[i];
+    double share = mispredictions ? 100.0 * e->mispredictions / mispredictions : 0;
+    cumulative += share;
+    printf("%4u 0x%08llx %10u %10u %8.3f %7.2f %7.2f %7.2f %7.2f\n", i + 1, (unsigned long long)e->pc, e->execs,
+           e->mispredictions, 1000.0 * e->mispredictions / e->execs, 100.0 * e->taken / e->execs,
+           100.0 * e->transitions / e->execs, share, cumulative);
+  }
+}
+
+void cleanup_profile()
+{
+  free(profile_table);
+}
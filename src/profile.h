@@ -0,0 +1,54 @@
+//========================================================//
+//  profile.h                                             //
+//  Header file for the per-PC misprediction profiler     //
+//                                                        //
+//  Counts executions, mispredictions, taken outcomes and //
+//  direction changes of every static conditional branch  //
+//========================================================//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//         Profile Defines            //
+//------------------------------------//
+#define PROFILE_INIT_LOG 12    // log2 initial slots of the hash table
+#define PROFILE_TOP_DEFAULT 20 // offenders printed by default
+
+// One static branch. Slots with execs == 0 are empty
+typedef struct
+{
+  uint64_t pc;
+  uint32_t execs;
+  uint32_t mispredictions;
+  uint32_t taken;
+  uint32_t transitions;   // outcome differs from the previous execution
+  uint32_t last;          // previous outcome
+} profile_entry;
+
+//------------------------------------//
+//        Profile Configuration       //
+//------------------------------------//
+extern int profileTop;         // Offenders to report (0 disables profiling)
+
+//------------------------------------//
+//     Profile Function Prototypes    //
+//------------------------------------//
+
+void init_profile();
+
+// Account one execution of the conditional branch at 'pc'
+//
+void profile_branch(uint64_t pc, uint32_t outcome, uint32_t mispredicted);
+
+// Print the profileTop branches with the most mispredictions and their
+// share of 'mispredictions', the total of the run
+//
+void print_profile(uint32_t mispredictions);
+
+void cleanup_profile();
+
+#endif
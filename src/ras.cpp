@@ -0,0 +1,154 @@
+//========================================================//
+//  ras.cpp                                               //
+//  Source file for the Return Address Stack model        //
+//                                                        //
+//  Fixed-depth stack with a configurable overflow policy //
+//  and optional checkpoint/repair of the speculative     //
+//  state after direction mispredictions                  //
+//========================================================//
+#include <stdio.h>
+#include "ras.h"
+
+//------------------------------------//
+//          RAS Configuration         //
+//------------------------------------//
+const char *rasOverflowName[2] = {"wrap", "stall"};
+const char *rasRepairName[3] = {"none", "tos", "top"};
+
+int rasDepth = 0;
+int rasOverflow = RAS_WRAP;
+int rasRepair = RAS_REPAIR_NONE;
+const char *rasWrongPath = "";   // ideal front-end, no wrong-path calls/returns
+
+//------------------------------------//
+//        RAS Data Structures         //
+//------------------------------------//
+uint64_t *ras_stack;   // call addresses
+int ras_tos;           // next free slot
+int ras_count;         // valid entries, at most rasDepth
+
+uint32_t ras_overflows;
+uint32_t ras_underflows;
+
+//------------------------------------//
+//           RAS Functions            //
+//------------------------------------//
+
+void init_ras()
+{
+  ras_stack = (uint64_t *)calloc(rasDepth, sizeof(uint64_t));
+  ras_tos = 0;
+  ras_count = 0;
+  ras_overflows = 0;
+  ras_underflows = 0;
+}
+
+static void ras_push(uint64_t addr)
+{
+  if (ras_count == rasDepth)
+  {
+    ras_overflows++;
+    if (rasOverflow == RAS_STALL)
+    {
+      return;   // keep the oldest entries, lose this return
+    }
+  }
+  else
+  {
+    ras_count++;
+  }
+  ras_stack[ras_tos] = addr;
+  ras_tos = (ras_tos + 1) % rasDepth;   // wrap overwrites the oldest entry
+}
+
+static uint64_t ras_pop()
+{
+  if (ras_count == 0)
+  {
+    ras_underflows++;
+    return 0;
+  }
+  ras_count--;
+  ras_tos = (ras_tos + rasDepth - 1) % rasDepth;
+  return ras_stack[ras_tos];
+}
+
+uint64_t ras_predict()
+{
+  if (ras_count == 0)
+  {
+    return 0;
+  }
+  return ras_stack[(ras_tos + rasDepth - 1) % rasDepth];
+}
+
+uint32_t ras_match(uint64_t predicted, uint64_t target)
+{
+  // unsigned compare covers 1 <= target - predicted <= RAS_MAX_CALL_LEN
+  return predicted != 0 && (target - predicted - 1) < RAS_MAX_CALL_LEN;
+}
+
+void train_ras(uint64_t pc, uint32_t call, uint32_t ret)
+{
+  if (ret)
+  {
+    ras_pop();
+  }
+  if (call)
+  {
+    ras_push(pc);
+  }
+}
+
+void ras_save(ras_checkpoint *cp)
+{
+  cp->tos = ras_tos;
+  cp->count = ras_count;
+  cp->top = ras_predict();
+}
+
+void ras_restore(ras_checkpoint *cp)
+{
+  if (rasRepair == RAS_REPAIR_NONE)
+  {
+    return;
+  }
+  ras_tos = cp->tos;
+  ras_count = cp->count;
+  if (rasRepair == RAS_REPAIR_TOP && ras_count > 0)
+  {
+    ras_stack[(ras_tos + rasDepth - 1) % rasDepth] = cp->top;
+  }
+}
+
+void ras_mispredict()
+{
+  if (rasWrongPath[0] == '\0')
+  {
+    return;
+  }
+
+  ras_checkpoint cp;
+  ras_save(&cp);
+
+  // the trace has no wrong-path instructions, replay the configured
+  // sequence of calls (pushing a bogus address) and returns instead
+  for (const char *op = rasWrongPath; *op; op++)
+  {
+    if (*op == 'c')
+    {
+      ras_push(0);
+    }
+    else if (*op == 'r')
+    {
+      ras_pop();
+    }
+  }
+
+  ras_restore(&cp);
+}
+
+void cleanup_ras()
+{
+  free(ras_stack);
+}
@@ -0,0 +1,87 @@
+//========================================================//
+//  ras.h                                                 //
+//  Header file for the Return Address Stack model        //
+//                                                        //
+//  Pushes on call records, pops on ret records and       //
+//  scores the popped address against the ret target      //
+//========================================================//
+
+#ifndef RAS_H
+#define RAS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          RAS Defines               //
+//------------------------------------//
+
+// The trace only holds the address of a call, not its length, so a
+// return is predicted correctly when its target lies within one x86
+// instruction (at most 15 bytes) after the call on top of the stack
+#define RAS_MAX_CALL_LEN 15
+
+// Overflow policies when a call is pushed onto a full stack
+#define RAS_WRAP 0    // circular, overwrite the oldest entry
+#define RAS_STALL 1   // drop the new entry, keep the oldest ones
+
+// Repair policies after a mispredicted conditional branch
+#define RAS_REPAIR_NONE 0   // keep the wrong-path state
+#define RAS_REPAIR_TOS 1    // restore the top-of-stack pointer
+#define RAS_REPAIR_TOP 2    // restore the pointer and the top entry
+extern const char *rasOverflowName[];
+extern const char *rasRepairName[];
+
+//------------------------------------//
+//          RAS Configuration         //
+//------------------------------------//
+extern int rasDepth;           // Number of entries (0 disables the RAS)
+extern int rasOverflow;        // Overflow policy
+extern int rasRepair;          // Checkpoint/repair policy
+extern const char *rasWrongPath; // Wrong-path calls ('c') and returns ('r')
+                                 // replayed after each direction misprediction
+
+// Speculative state saved at prediction time
+typedef struct
+{
+  int tos;
+  int count;
+  uint64_t top;
+} ras_checkpoint;
+
+//------------------------------------//
+//         RAS Statistics             //
+//------------------------------------//
+extern uint32_t ras_overflows;
+extern uint32_t ras_underflows;
+
+//------------------------------------//
+//       RAS Function Prototypes      //
+//------------------------------------//
+
+void init_ras();
+
+// Predict the return of a ret record: returns the address of the call
+// on top of the stack (0 when the stack is empty)
+//
+uint64_t ras_predict();
+
+// Returns 1 if the ret 'target' is the fall-through of call 'predicted'
+//
+uint32_t ras_match(uint64_t predicted, uint64_t target);
+
+// Push on calls, pop on returns
+//
+void train_ras(uint64_t pc, uint32_t call, uint32_t ret);
+
+void ras_save(ras_checkpoint *cp);
+void ras_restore(ras_checkpoint *cp);
+
+// Replay the configured wrong path after a mispredicted conditional
+// branch and repair the stack according to rasRepair
+//
+void ras_mispredict();
+
+void cleanup_ras();
+
+#endif
@@ -0,0 +1,148 @@
+//========================================================//
+//  regions.cpp                                           //
+//  Source file for weighted region simulation            //
+//                                                        //
+//  A child per region keeps the predictor state of the   //
+//  regions apart, its counters come back through a pipe  //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "regions.h"
+
+//------------------------------------//
+//       Regions Configuration        //
+//------------------------------------//
+const char *regionsFile = NULL;
+
+//------------------------------------//
+//           Regions State            //
+//------------------------------------//
+static int reportFd = -1;   // write end of the pipe, in a region child
+
+//------------------------------------//
+//         Regions Functions          //
+//------------------------------------//
+
+const char *run_regions()
+{
+  FILE *f = fopen(regionsFile, "r");
+  if (!f)
+  {
+    printf("Cannot read regions %s\n", regionsFile);
+    exit(1);
+  }
+  const char *slash = strrchr(regionsFile, '/');
+  int dirLen = slash ? (int)(slash - regionsFile + 1) : 0;
+
+  int numRegions = 0;
+  int status = 0;
+  int haveInstructions = 1;
+  double totalWeight = 0;
+  double branches = 0, mispredictions = 0, instructions = 0;
+  double indirect = 0, targetMispredictions = 0, returns = 0, returnMispredictions = 0;
+  char line[4096];
+  while (fgets(line, sizeof(line), f))
+  {
+    double weight;
+    char name[4096];
+    if (line[0] == '#' || sscanf(line, "%lf %4095s", &weight, name) != 2)
+    {
+      continue;
+    }
+    static char trace[8192];
+    if (name[0] == '/')
+    {
+      snprintf(trace, sizeof(trace), "%s", name);
+    }
+    else
+    {
+      snprintf(trace, sizeof(trace), "%.*s%s", dirLen, regionsFile, name);
+    }
+    numRegions++;
+    printf("Region %d: %s (weight %.6f)\n", numRegions, trace, weight);
+    fflush(stdout);
+
+    int fd[2];
+    if (pipe(fd))
+    {
+      perror("pipe");
+      exit(1);
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      perror("fork");
+      exit(1);
+    }
+    if (pid == 0)
+    {
+      fclose(f);
+      close(fd[0]);
+      reportFd = fd[1];
+      return trace;
+    }
+    close(fd[1]);
+    run_results r;
+    int got = read(fd[0], &r, sizeof(r)) == (ssize_t)sizeof(r);
+    close(fd[0]);
+    int child;
+    waitpid(pid, &child, 0);
+    int code = WIFEXITED(child) ? WEXITSTATUS(child) : 1;
+    if (!got || code == 1)
+    {
+      printf("Region %d failed\n", numRegions);
+      exit(1);
+    }
+    status = code > status ? code : status;
+
+    totalWeight += weight;
+    branches += weight * r.branches;
+    mispredictions += weight * r.mispredictions;
+    instructions += weight * r.instructions;
+    indirect += weight * r.indirect;
+    targetMispredictions += weight * r.target_mispredictions;
+    returns += weight * r.returns;
+    returnMispredictions += weight * r.return_mispredictions;
+    haveInstructions &= r.instructions != 0;
+  }
+  fclose(f);
+  if (!numRegions)
+  {
+    printf("No regions in %s\n", regionsFile);
+    exit(1);
+  }
+
+  // Every region stands for its weight of the program: ratios of the
+  // weighted counts
+  printf("Regions:         %10d\n", numRegions);
+  printf("Total Weight:    %10.3f\n", totalWeight);
+  printf("Weighted Misprediction Rate: %7.3f\n", 1000 * mispredictions / branches);
+  if (haveInstructions)
+  {
+    printf("Weighted MPKI:   %10.3f\n", 1000 * mispredictions / instructions);
+  }
+  if (indirect)
+  {
+    printf("Weighted Target Misprediction Rate: %7.3f\n", 1000 * targetMispredictions / indirect);
+  }
+  if (returns)
+  {
+    printf("Weighted Return Misprediction Rate: %7.3f\n", 1000 * returnMispredictions / returns);
+  }
+  exit(status);
+}
+
+void report_region(run_results *r)
+{
+  if (reportFd < 0)
+  {
+    return;
+  }
+  if (write(reportFd, r, sizeof(*r)) != (ssize_t)sizeof(*r))
+  {
+    perror("write");
+  }
+  close(reportFd);
+}
@@ -0,0 +1,39 @@
+//========================================================//
+//  regions.h                                             //
+//  Header file for weighted region simulation            //
+//                                                        //
+//  Runs the predictors on the representative regions of //
+//  a program (branchExtractor/gen_simpoints.sh) and      //
+//  combines their results by weight                      //
+//========================================================//
+
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "results.h"
+
+//------------------------------------//
+//       Regions Configuration        //
+//------------------------------------//
+extern const char *regionsFile;  // '<weight> <trace>' lines, traces relative
+                                 // to the file
+
+//------------------------------------//
+//    Regions Function Prototypes     //
+//------------------------------------//
+
+// Simulate every region of regionsFile in its own child process, one
+// after the other. Returns in each child with the trace of its region, the
+// child then runs as if started on that trace. The parent waits for the
+// children, prints the weighted results and exits
+//
+const char *run_regions();
+
+// Hand the results of a region to the parent, nothing outside of a
+// region child
+//
+void report_region(run_results *r);
+
+#endif
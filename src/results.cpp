@@ -0,0 +1,354 @@
+//========================================================//
+//  results.cpp                                           //
+//  Source file for the machine-readable results          //
+//                                                        //
+//  A run is flattened into one list of fields, written   //
+//  as a sectioned JSON object or as a CSV row            //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "predictor.h"
+#include "ittage.h"
+#include "ras.h"
+#include "results.h"
+
+//------------------------------------//
+//        Results Configuration       //
+//------------------------------------//
+const char *resultsJson = NULL;
+const char *resultsCsv = NULL;
+const char *resultsBaseline = NULL;
+double compareTolerance = 0.01;   // rates are printed with 3 decimals
+double compareSlowdown = 10;
+
+//------------------------------------//
+//      Results Data Structures       //
+//------------------------------------//
+#define FIELD_NULL 0   // unknown (no instruction count, model disabled)
+#define FIELD_STR 1
+#define FIELD_INT 2
+#define FIELD_REAL 3
+#define MAX_FIELDS 48
+
+typedef struct
+{
+  const char *section;   // JSON object holding the field
+  const char *key;
+  int type;
+  const char *str;
+  uint64_t num;
+  double real;
+} result_field;
+
+result_field fields[MAX_FIELDS];
+int num_fields;
+
+struct timespec results_start;
+
+//------------------------------------//
+//         Results Functions          //
+//------------------------------------//
+
+void results_begin()
+{
+  clock_gettime(CLOCK_MONOTONIC, &results_start);
+}
+
+void results_end(run_results *r)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  r->seconds = (end.tv_sec - results_start.tv_sec) + (end.tv_nsec - results_start.tv_nsec) * 1e-9;
+}
+
+// Returns the next free field, a report never outgrows MAX_FIELDS
+static result_field *add_field(const char *section, const char *key, int type)
+{
+  if (num_fields == MAX_FIELDS)
+  {
+    fprintf(stderr, "Too many result fields, raise MAX_FIELDS\n");
+    exit(1);
+  }
+  result_field *f = &fields[num_fields++];
+  f->section = section;
+  f->key = key;
+  f->type = type;
+  return f;
+}
+
+static void add_str(const char *section, const char *key, const char *str)
+{
+  add_field(section, key, FIELD_STR)->str = str;
+}
+
+static void add_int(const char *section, const char *key, uint64_t num)
+{
+  add_field(section, key, FIELD_INT)->num = num;
+}
+
+// Adds 'num', unknown when it is 0
+static void add_known_int(const char *section, const char *key, uint64_t num)
+{
+  add_field(section, key, num ? FIELD_INT : FIELD_NULL)->num = num;
+}
+
+// Adds 'num' / 'den' * 'scale', unknown when 'den' is 0
+static void add_ratio(const char *section, const char *key, double num, double den, double scale)
+{
+  add_field(section, key, den ? FIELD_REAL : FIELD_NULL)->real = den ? scale * num / den : 0;
+}
+
+// Flatten the run and the full predictor configuration. Keys are unique
+// across sections so a report can be searched by key alone
+static void collect_fields(run_results *r)
+{
+  num_fields = 0;
+  add_str("trace", "name", r->trace);
+  add_int("trace", "records", r->records);
+  add_known_int("trace", "instructions", r->instructions);
+
+  add_str("config", "predictor", bpName[bpType]);
+  add_int("config", "ghistory_bits", ghistoryBits);
+  add_int("config", "lhistory_bits", lhistoryBits);
+  add_int("config", "pc_index_bits", pcIndexBits);
+  add_str("config", "hist_mode", histModeName[histMode[bpType]]);
+  add_int("config", "path_bits", pathBits);
+  add_int("config", "delay", updateDelay);
+  add_int("config", "bimode_bits", bimodeBits);
+  add_int("config", "bimode_choice_bits", bimodeChoiceBits);
+  add_int("config", "yags_cache_bits", yagsCacheBits);
+  add_int("config", "yags_choice_bits", yagsChoiceBits);
+  add_int("config", "yags_tag_bits", yagsTagBits);
+  add_int("config", "ittage_tables", ittage ? ittageNumTables : 0);
+  add_int("config", "ittage_log_entries", ittageLogEntries);
+  add_int("config", "ras_depth", rasDepth);
+  add_str("config", "ras_overflow", rasOverflowName[rasOverflow]);
+  add_str("config", "ras_repair", rasRepairName[rasRepair]);
+  add_str("config", "ras_wrongpath", rasWrongPath);
+
+  add_int("results", "branches", r->branches);
+  add_int("results", "mispredictions", r->mispredictions);
+  add_ratio("results", "misprediction_rate", r->mispredictions, r->branches, 1000);
+  add_ratio("results", "mpki", r->mispredictions, r->instructions, 1000);
+  add_int("results", "indirect", r->indirect);
+  add_int("results", "target_mispredictions", r->target_mispredictions);
+  add_ratio("results", "target_misprediction_rate", r->target_mispredictions, r->indirect, 1000);
+  add_int("results", "returns", r->returns);
+  add_int("results", "return_mispredictions", r->return_mispredictions);
+  add_ratio("results", "return_misprediction_rate", r->return_mispredictions, r->returns, 1000);
+
+  add_ratio("timing", "seconds", r->seconds, 1, 1);
+  add_ratio("timing", "records_per_sec", r->records, r->seconds, 1);
+  add_ratio("timing", "branches_per_sec", r->branches, r->seconds, 1);
+}
+
+// Open 'path' for writing, "-" is stdout
+static FILE *open_output(const char *path, const char *mode)
+{
+  if (!strcmp(path, "-"))
+  {
+    return stdout;
+  }
+  FILE *f = fopen(path, mode);
+  if (!f)
+  {
+    fprintf(stderr, "Cannot write %s\n", path);
+  }
+  return f;
+}
+
+static void close_output(FILE *f)
+{
+  if (f != stdout)
+  {
+    fclose(f);
+  }
+}
+
+// Write a string, escaping the characters JSON and CSV quote
+static void write_quoted(FILE *f, const char *s, char quote)
+{
+  fputc('"', f);
+  for (; *s; s++)
+  {
+    if (*s == '"')
+    {
+      fputc(quote, f);
+    }
+    else if (*s == '\\' && quote == '\\')
+    {
+      fputc('\\', f);
+    }
+    fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static void write_value(FILE *f, result_field *field, char quote, const char *null)
+{
+  switch (field->type)
+  {
+  case FIELD_STR:
+    write_quoted(f, field->str, quote);
+    break;
+  case FIELD_INT:
+    fprintf(f, "%llu", (unsigned long long)field->num);
+    break;
+  case FIELD_REAL:
+    fprintf(f, "%.6f", field->real);
+    break;
+  default:
+    fputs(null, f);
+    break;
+  }
+}
+
+void write_json(run_results *r)
+{
+  FILE *f = open_output(resultsJson, "w");
+  if (!f)
+  {
+    return;
+  }
+  collect_fields(r);
+  fprintf(f, "{");
+  for (int i = 0; i < num_fields; i++)
+  {
+    if (!i || strcmp(fields[i].section, fields[i - 1].section))
+    {
+      fprintf(f, "%s\n  \"%s\": {", i ? "\n  }," : "", fields[i].section);
+    }
+    else
+    {
+      fprintf(f, ",");
+    }
+    fprintf(f, "\n    \"%s\": ", fields[i].key);
+    write_value(f, &fields[i], '\\', "null");
+  }
+  fprintf(f, "\n  }\n}\n");
+  close_output(f);
+}
+
+void write_csv(run_results *r)
+{
+  // a new (or empty) file gets the header row first
+  FILE *f = open_output(resultsCsv, "a");
+  if (!f)
+  {
+    return;
+  }
+  collect_fields(r);
+  if (f == stdout || ftell(f) == 0)
+  {
+    for (int i = 0; i < num_fields; i++)
+    {
+      fprintf(f, "%s%s", i ? "," : "", fields[i].key);
+    }
+    fprintf(f, "\n");
+  }
+  for (int i = 0; i < num_fields; i++)
+  {
+    if (i)
+    {
+      fputc(',', f);
+    }
+    write_value(f, &fields[i], '"', "");
+  }
+  fprintf(f, "\n");
+  close_output(f);
+}
+
+// Find '"key": ' in a report written by write_json
+//
+// Returns a pointer to the value, NULL if the key is missing
+//
+static const char *json_value(const char *json, const char *key)
+{
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  const char *p = strstr(json, pattern);
+  if (!p)
+  {
+    return NULL;
+  }
+  p += strlen(pattern);
+  while (*p == ' ')
+  {
+    p++;
+  }
+  return p;
+}
+
+// Returns True if 'key' holds a number, stored in 'value'
+//
+static int json_number(const char *json, const char *key, double *value)
+{
+  const char *p = json_value(json, key);
+  if (!p || !strncmp(p, "null", 4))
+  {
+    return 0;
+  }
+  *value = strtod(p, NULL);
+  return 1;
+}
+
+// Returns True if the string 'key' equals 'str'
+//
+static int json_string_is(const char *json, const char *key, const char *str)
+{
+  const char *p = json_value(json, key);
+  return p && *p == '"' && !strncmp(p + 1, str, strlen(str)) && p[1 + strlen(str)] == '"';
+}
+
+int compare_baseline(run_results *r)
+{
+  FILE *f = fopen(resultsBaseline, "r");
+  if (!f)
+  {
+    printf("Cannot read baseline %s\n", resultsBaseline);
+    return 1;
+  }
+  char *json = NULL;
+  size_t size = 0;
+  getdelim(&json, &size, '\0', f);
+  fclose(f);
+
+  collect_fields(r);
+  if (!json_string_is(json, "predictor", bpName[bpType]) || !json_string_is(json, "name", r->trace))
+  {
+    printf("Compare: baseline was produced by another predictor or trace\n");
+  }
+
+  // accuracy, in mispredictions per 1000 of the kind
+  int regressions = 0;
+  for (int i = 0; i < num_fields; i++)
+  {
+    double base;
+    if (fields[i].type != FIELD_REAL || !strstr(fields[i].key, "_rate") ||
+        !json_number(json, fields[i].key, &base))
+    {
+      continue;
+    }
+    double diff = fields[i].real - base;
+    int fail = diff > compareTolerance || diff < -compareTolerance;
+    printf("Compare %-26s %9.3f -> %9.3f (%+.3f) %s\n", fields[i].key, base, fields[i].real, diff,
+           fail ? "CHANGED" : "ok");
+    regressions += fail;
+  }
+
+  // throughput, only a slowdown fails
+  double base_rps;
+  if (r->seconds > 0 && json_number(json, "records_per_sec", &base_rps) && base_rps > 0)
+  {
+    double rps = r->records / r->seconds;
+    double change = 100.0 * (rps - base_rps) / base_rps;
+    int fail = change < -compareSlowdown;
+    printf("Compare %-26s %9.0f -> %9.0f (%+.1f%%) %s\n", "records_per_sec", base_rps, rps, change,
+           fail ? "SLOWER" : "ok");
+    regressions += fail;
+  }
+  printf("Compare: %s\n", regressions ? "FAIL" : "PASS");
+  free(json);
+  return regressions;
+}
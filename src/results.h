@@ -0,0 +1,60 @@
+//========================================================//
+//  results.h                                             //
+//  Header file for the machine-readable results          //
+//                                                        //
+//  JSON/CSV reports of a run and comparison of a run     //
+//  against a baseline JSON report                        //
+//========================================================//
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//        Results Configuration       //
+//------------------------------------//
+extern const char *resultsJson;     // JSON report file ("-" for stdout)
+extern const char *resultsCsv;      // CSV file, a row is appended per run
+extern const char *resultsBaseline; // JSON report to compare against
+extern double compareTolerance;     // allowed change of a misprediction rate
+extern double compareSlowdown;      // allowed throughput loss in percent
+
+// Everything main() measured during the run
+typedef struct
+{
+  const char *trace;      // trace file, "stdin" when piped
+  uint64_t records;
+  uint64_t instructions;  // 0 when unknown
+  uint64_t branches;
+  uint64_t mispredictions;
+  uint64_t indirect;
+  uint64_t target_mispredictions;
+  uint64_t returns;
+  uint64_t return_mispredictions;
+  double seconds;
+} run_results;
+
+//------------------------------------//
+//    Results Function Prototypes     //
+//------------------------------------//
+
+// Start the wall clock of the run
+//
+void results_begin();
+
+// Stop the wall clock and fill in r->seconds
+//
+void results_end(run_results *r);
+
+void write_json(run_results *r);
+void write_csv(run_results *r);
+
+// Compare the run with the resultsBaseline report
+//
+// Returns the number of regressions (0 if the run passes)
+//
+int compare_baseline(run_results *r);
+
+#endif
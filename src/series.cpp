@@ -0,0 +1,106 @@
+//========================================================//
+//  series.cpp                                            //
+//  Source file for the interval time series              //
+//                                                        //
+//  Rows are the difference of the loop's running totals  //
+//  at consecutive interval boundaries                    //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include "series.h"
+
+//------------------------------------//
+//        Series Configuration        //
+//------------------------------------//
+const char *seriesColumnName[SERIES_COLUMNS] = {"branches", "mispredictions", "indirect",
+                                                "target_mispredictions", "returns",
+                                                "return_mispredictions"};
+
+uint32_t seriesInterval = 0;
+const char *seriesFile = "-";
+
+uint64_t series_next = ~0ull;
+
+//------------------------------------//
+//       Series Data Structures       //
+//------------------------------------//
+FILE *series_out;
+int series_binary;
+uint32_t series_last[SERIES_COLUMNS];   // totals at the previous boundary
+
+//------------------------------------//
+//          Series Functions          //
+//------------------------------------//
+
+void init_series()
+{
+  size_t len = strlen(seriesFile);
+  series_binary = len > 4 && !strcmp(seriesFile + len - 4, ".bin");
+  series_out = strcmp(seriesFile, "-") ? fopen(seriesFile, series_binary ? "wb" : "w") : stdout;
+  if (!series_out)
+  {
+    fprintf(stderr, "Cannot write %s\n", seriesFile);
+    return;
+  }
+  memset(series_last, 0, sizeof(series_last));
+  series_next = seriesInterval;
+
+  if (series_binary)
+  {
+    series_header header = {SERIES_MAGIC, SERIES_VERSION, seriesInterval, SERIES_COLUMNS};
+    fwrite(&header, sizeof(header), 1, series_out);
+  }
+  else
+  {
+    fprintf(series_out, "interval");
+    for (int i = 0; i < SERIES_COLUMNS; i++)
+    {
+      fprintf(series_out, ",%s", seriesColumnName[i]);
+    }
+    fprintf(series_out, "\n");
+  }
+}
+
+static void series_row(uint32_t *totals)
+{
+  uint32_t row[SERIES_COLUMNS];
+  for (int i = 0; i < SERIES_COLUMNS; i++)
+  {
+    row[i] = totals[i] - series_last[i];
+    series_last[i] = totals[i];
+  }
+
+  if (series_binary)
+  {
+    fwrite(row, sizeof(row), 1, series_out);
+    return;
+  }
+  fprintf(series_out, "%llu", (unsigned long long)(series_next / seriesInterval - 1));
+  for (int i = 0; i < SERIES_COLUMNS; i++)
+  {
+    fprintf(series_out, ",%u", row[i]);
+  }
+  fprintf(series_out, "\n");
+}
+
+void series_emit(uint32_t *totals)
+{
+  series_row(totals);
+  series_next += seriesInterval;
+}
+
+void cleanup_series(uint32_t *totals)
+{
+  if (!series_out)
+  {
+    return;
+  }
+  if (totals[SERIES_BRANCHES] != series_last[SERIES_BRANCHES])
+  {
+    series_row(totals);
+  }
+  if (series_out != stdout)
+  {
+    fclose(series_out);
+  }
+}
@@ -0,0 +1,66 @@
+//========================================================//
+//  series.h                                              //
+//  Header file for the interval time series              //
+//                                                        //
+//  Misprediction counts of every model per interval of   //
+//  conditional branches, for phase analysis              //
+//========================================================//
+
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Series Defines            //
+//------------------------------------//
+// Binary series: a header, then one row of SERIES_COLUMNS host-endian
+// uint32_t counts per interval (the last interval may be shorter)
+#define SERIES_MAGIC 0x53495042   // "BPIS"
+#define SERIES_VERSION 1
+#define SERIES_COLUMNS 6
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t interval;   // conditional branches per interval
+  uint32_t columns;
+} series_header;
+
+// Columns of a row, deltas over the interval
+#define SERIES_BRANCHES 0
+#define SERIES_MISPREDICTIONS 1
+#define SERIES_INDIRECT 2
+#define SERIES_TARGET_MISPREDICTIONS 3
+#define SERIES_RETURNS 4
+#define SERIES_RETURN_MISPREDICTIONS 5
+extern const char *seriesColumnName[];
+
+//------------------------------------//
+//        Series Configuration        //
+//------------------------------------//
+extern uint32_t seriesInterval;    // 0 disables the series
+extern const char *seriesFile;     // "-" for stdout, binary if it ends in .bin
+
+// Conditional branch count closing the current interval. Never reached
+// when the series is disabled, so the hot loop only pays a compare
+extern uint64_t series_next;
+
+//------------------------------------//
+//     Series Function Prototypes     //
+//------------------------------------//
+
+void init_series();
+
+// Emit the row of the interval ending now from the running totals of
+// the simulation loop and move series_next to the next boundary
+//
+void series_emit(uint32_t *totals);
+
+// Emit the partial last interval and close the output
+//
+void cleanup_series(uint32_t *totals);
+
+#endif
@@ -0,0 +1,376 @@
+//========================================================//
+//  simpoint.cpp                                          //
+//  Representative regions of a basic block profile      //
+//                                                        //
+//  Clusters the intervals of a branchExtractor -bbv      //
+//  profile like SimPoint (random projection, k-means,    //
+//  BIC choice of k) and prints one interval per cluster  //
+//  with the fraction of the program it stands for        //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+//------------------------------------//
+//     Clustering Configuration       //
+//------------------------------------//
+uint64_t seed = 1;
+int maxK = 10;          // largest number of clusters tried
+int dims = 15;          // dimensions after the random projection
+int restarts = 5;       // k-means runs per k, the tightest one is kept
+int maxIters = 100;     // k-means iterations per run
+double bicThreshold = 0.9;  // smallest k reaching this part of the BIC range
+const char *bbFile = NULL;
+
+//------------------------------------//
+//          Clustering State          //
+//------------------------------------//
+uint64_t rng_state;
+std::vector<double> points;   // intervals x dims, projected
+std::vector<double> sizes;    // instructions of each interval, the last
+int numPoints = 0;            // one of a profile is usually partial
+
+static uint64_t next_random()
+{
+  // xorshift64*, as in tracegen
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dull;
+}
+
+// Entry of the projection matrix for a block and a dimension, uniform in
+// [-1, 1], derived from the seed so the matrix needs no storage
+static double projection(uint64_t block, int dim)
+{
+  uint64_t x = (seed * 0x9e3779b97f4a7c15ull) ^ (block * 0xbf58476d1ce4e5b9ull) ^ ((uint64_t)dim * 0x94d049bb133111ebull);
+  x ^= x >> 31;
+  x *= 0xd6e8feb86659fd3bull;
+  x ^= x >> 32;
+  return (double)(x >> 11) / (double)(1ull << 52) - 1.0;
+}
+
+// Read 'T:<id>:<count> :<id>:<count> ...' lines, one per interval, and
+// project each vector, normalized to a sum of 1. The sum of the counts
+// is the size of the interval
+//
+// Returns True if Successful
+//
+int read_profile(FILE *f)
+{
+  char *line = NULL;
+  size_t len = 0;
+  std::vector<uint64_t> ids;
+  std::vector<double> counts;
+  while (getline(&line, &len, f) != -1)
+  {
+    if (line[0] != 'T')
+    {
+      continue;
+    }
+    ids.clear();
+    counts.clear();
+    double total = 0;
+    char *p = line + 1;
+    unsigned long long id, count;
+    int n;
+    while (sscanf(p, " :%llu:%llu%n", &id, &count, &n) == 2)
+    {
+      ids.push_back(id);
+      counts.push_back((double)count);
+      total += count;
+      p += n;
+    }
+    numPoints++;
+    sizes.push_back(total);
+    points.resize((size_t)numPoints * dims, 0.0);
+    double *x = &points[(size_t)(numPoints - 1) * dims];
+    for (size_t b = 0; b < ids.size() && total > 0; b++)
+    {
+      for (int d = 0; d < dims; d++)
+      {
+        x[d] += counts[b] / total * projection(ids[b], d);
+      }
+    }
+  }
+  free(line);
+  return numPoints > 0;
+}
+
+static double distance2(const double *a, const double *b)
+{
+  double sum = 0;
+  for (int d = 0; d < dims; d++)
+  {
+    sum += (a[d] - b[d]) * (a[d] - b[d]);
+  }
+  return sum;
+}
+
+// One k-means run from k distinct random intervals
+//
+// Returns the sum of squared distances to the centers
+//
+double kmeans(int k, std::vector<double> &centers, std::vector<int> &assign)
+{
+  centers.assign((size_t)k * dims, 0.0);
+  assign.assign(numPoints, -1);
+  std::vector<int> picked;
+  for (int c = 0; c < k; c++)
+  {
+    int p;
+    int unique;
+    do
+    {
+      p = (int)(next_random() % numPoints);
+      unique = 1;
+      for (size_t i = 0; i < picked.size(); i++)
+      {
+        unique &= picked[i] != p;
+      }
+    } while (!unique);
+    picked.push_back(p);
+    memcpy(&centers[(size_t)c * dims], &points[(size_t)p * dims], dims * sizeof(double));
+  }
+
+  double error = 0;
+  std::vector<int> size(k);
+  for (int iter = 0; iter < maxIters; iter++)
+  {
+    int changed = 0;
+    error = 0;
+    for (int p = 0; p < numPoints; p++)
+    {
+      int best = 0;
+      double bestDist = distance2(&points[(size_t)p * dims], &centers[0]);
+      for (int c = 1; c < k; c++)
+      {
+        double dist = distance2(&points[(size_t)p * dims], &centers[(size_t)c * dims]);
+        if (dist < bestDist)
+        {
+          best = c;
+          bestDist = dist;
+        }
+      }
+      changed |= assign[p] != best;
+      assign[p] = best;
+      error += bestDist;
+    }
+    if (!changed)
+    {
+      break;
+    }
+
+    // move the centers to the means, an emptied cluster keeps its center
+    std::vector<double> sum((size_t)k * dims, 0.0);
+    size.assign(k, 0);
+    for (int p = 0; p < numPoints; p++)
+    {
+      size[assign[p]]++;
+      for (int d = 0; d < dims; d++)
+      {
+        sum[(size_t)assign[p] * dims + d] += points[(size_t)p * dims + d];
+      }
+    }
+    for (int c = 0; c < k; c++)
+    {
+      for (int d = 0; size[c] && d < dims; d++)
+      {
+        centers[(size_t)c * dims + d] = sum[(size_t)c * dims + d] / size[c];
+      }
+    }
+  }
+  return error;
+}
+
+// Bayesian Information Criterion of a clustering, under the spherical
+// Gaussian model of X-means (Pelleg and Moore), as used by SimPoint
+double bic(int k, double error, const std::vector<int> &assign)
+{
+  double R = numPoints;
+  double M = dims;
+  double variance = R > k ? error / (R - k) : 0;
+  if (variance <= 0)
+  {
+    variance = 1e-300;
+  }
+  std::vector<int> size(k, 0);
+  for (int p = 0; p < numPoints; p++)
+  {
+    size[assign[p]]++;
+  }
+  double likelihood = 0;
+  for (int c = 0; c < k; c++)
+  {
+    double Rn = size[c];
+    if (Rn > 0)
+    {
+      likelihood += Rn * log(Rn) - Rn * log(R) - Rn / 2 * log(2 * M_PI) - Rn * M / 2 * log(variance) - (Rn - k) / 2;
+    }
+  }
+  double parameters = (k - 1) + M * k + 1;
+  return likelihood - parameters / 2 * log(R);
+}
+
+void usage()
+{
+  fprintf(stderr, "Usage: simpoint <options> <profile.bb>\n");
+  fprintf(stderr, "       Prints '<interval> <weight>' for each representative\n"
+                  "       interval of a branchExtractor -bbv profile\n");
+  fprintf(stderr, " Options:\n");
+  fprintf(stderr, " --help             Print this message\n");
+  fprintf(stderr, " --k:<n>            Most clusters tried (default 10)\n");
+  fprintf(stderr, " --dim:<n>          Dimensions of the projection (default 15)\n");
+  fprintf(stderr, " --seed:<n>         Random seed (default 1)\n");
+  fprintf(stderr, " --restarts:<n>     k-means runs per k (default 5)\n");
+  fprintf(stderr, " --iters:<n>        Iterations per run (default 100)\n");
+  fprintf(stderr, " --bic:<fraction>   Pick the smallest k scoring this part of\n"
+                  "                    the BIC range (default 0.9)\n");
+}
+
+int handle_option(char *arg)
+{
+  if (!strncmp(arg, "--k:", 4))
+  {
+    maxK = atoi(arg + 4);
+    return maxK > 0;
+  }
+  else if (!strncmp(arg, "--dim:", 6))
+  {
+    dims = atoi(arg + 6);
+    return dims > 0;
+  }
+  else if (!strncmp(arg, "--seed:", 7))
+  {
+    seed = strtoull(arg + 7, NULL, 0);
+  }
+  else if (!strncmp(arg, "--restarts:", 11))
+  {
+    restarts = atoi(arg + 11);
+    return restarts > 0;
+  }
+  else if (!strncmp(arg, "--iters:", 8))
+  {
+    maxIters = atoi(arg + 8);
+    return maxIters > 0;
+  }
+  else if (!strncmp(arg, "--bic:", 6))
+  {
+    bicThreshold = atof(arg + 6);
+    return bicThreshold >= 0 && bicThreshold <= 1;
+  }
+  else
+  {
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      usage();
+      exit(0);
+    }
+    else if (!strncmp(argv[i], "--", 2))
+    {
+      if (!handle_option(argv[i]))
+      {
+        fprintf(stderr, "Unrecognized option %s\n", argv[i]);
+        usage();
+        exit(1);
+      }
+    }
+    else
+    {
+      bbFile = argv[i];
+    }
+  }
+
+  FILE *f = bbFile ? fopen(bbFile, "r") : stdin;
+  if (!f || !read_profile(f))
+  {
+    fprintf(stderr, "Cannot read profile %s\n", bbFile ? bbFile : "stdin");
+    exit(1);
+  }
+  if (f != stdin)
+  {
+    fclose(f);
+  }
+  rng_state = seed ? seed : 1;
+
+  // Best clustering for every k, then the smallest k close enough to the
+  // best score
+  int kLimit = maxK < numPoints ? maxK : numPoints;
+  std::vector<std::vector<double> > bestCenters(kLimit + 1);
+  std::vector<std::vector<int> > bestAssign(kLimit + 1);
+  std::vector<double> score(kLimit + 1);
+  for (int k = 1; k <= kLimit; k++)
+  {
+    double bestError = -1;
+    for (int r = 0; r < restarts; r++)
+    {
+      std::vector<double> centers;
+      std::vector<int> assign;
+      double error = kmeans(k, centers, assign);
+      if (bestError < 0 || error < bestError)
+      {
+        bestError = error;
+        bestCenters[k] = centers;
+        bestAssign[k] = assign;
+      }
+    }
+    score[k] = bic(k, bestError, bestAssign[k]);
+    fprintf(stderr, "k %2d BIC %.3f\n", k, score[k]);
+  }
+  double low = score[1];
+  double high = score[1];
+  for (int k = 2; k <= kLimit; k++)
+  {
+    low = score[k] < low ? score[k] : low;
+    high = score[k] > high ? score[k] : high;
+  }
+  int k = 1;
+  while (k < kLimit && score[k] < low + bicThreshold * (high - low))
+  {
+    k++;
+  }
+
+  // The interval closest to each center represents its cluster, weighted
+  // by the instructions of the cluster
+  std::vector<int> rep(k, -1);
+  std::vector<double> repDist(k, 0);
+  std::vector<double> size(k, 0);
+  double instructions = 0;
+  for (int p = 0; p < numPoints; p++)
+  {
+    int c = bestAssign[k][p];
+    double dist = distance2(&points[(size_t)p * dims], &bestCenters[k][(size_t)c * dims]);
+    size[c] += sizes[p];
+    instructions += sizes[p];
+    if (rep[c] < 0 || dist < repDist[c])
+    {
+      rep[c] = p;
+      repDist[c] = dist;
+    }
+  }
+  fprintf(stderr, "%d intervals, %d clusters\n", numPoints, k);
+  for (int p = 0; p < numPoints; p++)
+  {
+    for (int c = 0; c < k; c++)
+    {
+      if (rep[c] == p)
+      {
+        printf("%d %.6f\n", p, instructions > 0 ? size[c] / instructions : 0.0);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+//========================================================//
+//  stats.cpp                                             //
+//  Source file for the simulator throughput statistics   //
+//                                                        //
+//  Sampled per-stage timing of the simulation loop,      //
+//  calibrated against the wall clock at the end of run   //
+//========================================================//
+#include <stdio.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+//------------------------------------//
+//          Stats State               //
+//------------------------------------//
+const char *stageName[NUM_STAGES] = {"input", "decode", "predict", "train"};
+
+int statsEnabled = 0;
+int stats_sampling = 0;
+int stats_countdown = 1;   // time the very first record
+uint64_t stats_stamp[NUM_STAGES + 1];
+
+uint64_t stats_ticks[NUM_STAGES];   // ticks spent in each stage by sampled records
+uint64_t stats_samples;             // sampled records
+uint64_t stats_overhead;            // ticks of one timestamp, removed from each stage
+uint64_t stats_start_tsc;
+struct timespec stats_start_time;
+
+//------------------------------------//
+//          Stats Functions           //
+//------------------------------------//
+
+void stats_begin()
+{
+  for (int i = 0; i < NUM_STAGES; i++)
+  {
+    stats_ticks[i] = 0;
+  }
+  stats_samples = 0;
+
+  // cost of back-to-back timestamps, so it is not charged to the stages
+  stats_overhead = ~0ull;
+  for (int i = 0; i < 1000; i++)
+  {
+    uint64_t t0 = read_tsc();
+    uint64_t t1 = read_tsc();
+    if (t1 - t0 < stats_overhead)
+    {
+      stats_overhead = t1 - t0;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &stats_start_time);
+  stats_start_tsc = read_tsc();
+}
+
+void stats_account()
+{
+  for (int i = 0; i < NUM_STAGES; i++)
+  {
+    uint64_t ticks = stats_stamp[i + 1] - stats_stamp[i];
+    stats_ticks[i] += (ticks > stats_overhead) ? ticks - stats_overhead : 0;
+  }
+  stats_samples++;
+  stats_sampling = 0;
+}
+
+void stats_end(uint64_t records, uint64_t branches)
+{
+  uint64_t end_tsc = read_tsc();
+  struct timespec end_time;
+  clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+  double seconds = (end_time.tv_sec - stats_start_time.tv_sec) +
+                   (end_time.tv_nsec - stats_start_time.tv_nsec) * 1e-9;
+  double ticks_per_ns = (double)(end_tsc - stats_start_tsc) / (seconds * 1e9);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("Elapsed:         %10.3f s\n", seconds);
+  printf("Records/sec:     %10.0f\n", records / seconds);
+  printf("Branches/sec:    %10.0f\n", branches / seconds);
+  printf("ns/branch:       %10.1f\n", branches ? seconds * 1e9 / branches : 0.0);
+  printf("ns/record:       %10.1f\n", seconds * 1e9 / records);
+
+  // Timing perturbs the sampled records, so the sampled stage times are
+  // only used to split the measured ns/record, and add up to it
+  uint64_t sampled = 0;
+  for (int i = 0; i < NUM_STAGES; i++)
+  {
+    sampled += stats_ticks[i];
+  }
+  if (sampled)
+  {
+    for (int i = 0; i < NUM_STAGES; i++)
+    {
+      double share = (double)stats_ticks[i] / sampled;
+      printf("  %-8s       %10.1f ns  (sampled %.1f ns)\n", stageName[i],
+             share * seconds * 1e9 / records, stats_ticks[i] / ticks_per_ns / stats_samples);
+    }
+  }
+  printf("Peak RSS:        %10ld KB\n", usage.ru_maxrss);
+}
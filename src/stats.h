@@ -0,0 +1,109 @@
+//========================================================//
+//  stats.h                                               //
+//  Header file for the simulator throughput statistics   //
+//                                                        //
+//  Every STATS_SAMPLE_PERIOD-th trace record is timed    //
+//  stage by stage with the TSC (monotonic clock else)    //
+//========================================================//
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//------------------------------------//
+//          Stats Defines             //
+//------------------------------------//
+// Records between two timed records. Prime, so sampling does not beat
+// against the power-of-two stdio buffer refills of fixed-width records
+#define STATS_SAMPLE_PERIOD 61
+
+// Stages of the simulation loop, timed in this order
+#define STAGE_INPUT 0     // reading a line of the trace
+#define STAGE_DECODE 1    // parsing the record
+#define STAGE_PREDICT 2   // direction, target and return predictions
+#define STAGE_TRAIN 3     // training every enabled model
+#define NUM_STAGES 4
+extern const char *stageName[];
+
+//------------------------------------//
+//          Stats State               //
+//------------------------------------//
+extern int statsEnabled;
+extern int stats_sampling;     // the current record is being timed
+extern int stats_countdown;    // records until the next timed one
+extern uint64_t stats_stamp[NUM_STAGES + 1];
+
+// Cheap cycle-granularity timestamp
+static inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// Start timing the next record if it is a sampled one
+#define STATS_RECORD_BEGIN()                           \
+  do                                                   \
+  {                                                    \
+    if (statsEnabled && --stats_countdown == 0)        \
+    {                                                  \
+      stats_sampling = 1;                              \
+      stats_countdown = STATS_SAMPLE_PERIOD;           \
+      stats_stamp[0] = read_tsc();                     \
+    }                                                  \
+  } while (0)
+
+// Mark the end of 'stage' for a sampled record
+#define STATS_STAMP(stage)                             \
+  do                                                   \
+  {                                                    \
+    if (stats_sampling)                                \
+    {                                                  \
+      stats_stamp[(stage) + 1] = read_tsc();           \
+    }                                                  \
+  } while (0)
+
+// Drop the timing of a record that is not simulated
+#define STATS_RECORD_CANCEL()                          \
+  do                                                   \
+  {                                                    \
+    stats_sampling = 0;                                \
+  } while (0)
+
+// Account a sampled record once all of its stages are stamped
+#define STATS_RECORD_END()                             \
+  do                                                   \
+  {                                                    \
+    if (stats_sampling)                                \
+    {                                                  \
+      stats_account();                                 \
+    }                                                  \
+  } while (0)
+
+//------------------------------------//
+//      Stats Function Prototypes     //
+//------------------------------------//
+
+// Start the wall clock and TSC reference of the run
+//
+void stats_begin();
+
+void stats_account();
+
+// Stop the clocks and print throughput, ns per record and per scored
+// conditional branch, the split of a record's time across the stages
+// and peak RSS
+//
+void stats_end(uint64_t records, uint64_t branches);
+
+#endif
@@ -0,0 +1,433 @@
+//========================================================//
+//  tracegen.cpp                                          //
+//  Synthetic branch trace generator                      //
+//                                                        //
+//  Streams records in the branchExtractor text (or      //
+//  binary) format from a seeded, weighted mix of branch  //
+//  patterns                                              //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "bintrace.h"
+
+// Pattern kinds, picked per step by weight
+#define GEN_LOOP 0     // nested loops with fixed or variable trip counts
+#define GEN_CORR 1     // pairs of correlated conditional branches
+#define GEN_BIAS 2     // biased random conditional branches
+#define GEN_CALL 3     // call/return chains
+#define GEN_SWITCH 4   // indirect switch dispatch
+#define GEN_KINDS 5
+const char *genName[GEN_KINDS] = {"loop", "corr", "bias", "call", "switch"};
+
+#define MAX_NEST 8
+#define MAX_CASES 256
+
+//------------------------------------//
+//      Generator Configuration       //
+//------------------------------------//
+uint64_t seed = 1;
+uint64_t maxRecords = 10000000;   // records to emit
+int weight[GEN_KINDS] = {4, 2, 2, 1, 1};
+int sites = 64;                   // static instances of each pattern
+int tripMin = 4;                  // loop trip counts, fixed when min == max
+int tripMax = 16;
+int nestDepth = 2;                // loop nesting depth
+int biasPercent = 90;             // taken probability of a biased branch site
+int corrNoise = 0;                // percent of correlated pairs that disagree
+int callDepth = 4;                // deepest call chain
+int switchCases = 16;             // targets of each switch
+int switchLocality = 75;          // percent of dispatches following the previous case
+int bbSize = 6;                   // instructions per branch, for the info file
+const char *infoFile = NULL;
+int binaryOutput = 0;             // bintrace.h records instead of text
+
+//------------------------------------//
+//          Generator State           //
+//------------------------------------//
+uint64_t rng_state;
+uint64_t records = 0;
+uint64_t cbcount = 0;
+uint64_t ubcount = 0;
+uint64_t callcount = 0;
+uint64_t retcount = 0;
+uint8_t *switch_last;             // previous case of each switch site
+uint32_t last_pc = 0;             // pc of the previous binary record
+
+static uint64_t gen_random()
+{
+  // xorshift64*, reproducible from the seed on every platform
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dull;
+}
+
+static uint32_t gen_range(uint32_t n)
+{
+  return (uint32_t)((gen_random() >> 32) % n);
+}
+
+// Code address of a branch: each kind and site gets its own 64KB region,
+// offset by an odd stride so sites also differ in their low PC bits
+static uint32_t site_pc(int kind, int site, int slot)
+{
+  return 0x10000000 + ((uint32_t)kind << 24) + ((uint32_t)site << 16) + ((site * 0x2a4) & 0x7fff) + slot * 0x20;
+}
+
+static int emit(uint32_t pc, uint32_t target, int taken, int cond, int call, int ret, int direct)
+{
+  if (records >= maxRecords)
+  {
+    return 0;
+  }
+  if (binaryOutput)
+  {
+    uint8_t record[BT_MAX_RECORD];
+    uint8_t *p = record;
+    *p++ = (taken ? BT_TAKEN : 0) | (cond ? BT_COND : 0) | (call ? BT_CALL : 0) | (ret ? BT_RET : 0) |
+           (direct ? BT_DIRECT : 0);
+    p = bt_put_delta(p, (int64_t)pc - (int64_t)last_pc);
+    p = bt_put_delta(p, (int64_t)target - (int64_t)pc);
+    last_pc = pc;
+    fwrite(record, p - record, 1, stdout);
+  }
+  else
+  {
+    printf("0x%x\t0x%x\t%d\t%d\t%d\t%d\t%d\n", pc, target, taken, cond, call, ret, direct);
+  }
+  records++;
+  if (cond)
+  {
+    cbcount++;
+  }
+  else
+  {
+    ubcount++;
+  }
+  callcount += call;
+  retcount += ret;
+  return 1;
+}
+
+static int trip_count()
+{
+  return tripMin == tripMax ? tripMin : tripMin + gen_range(tripMax - tripMin + 1);
+}
+
+// One entry of the loop nest at 'level', innermost at nestDepth - 1
+static void gen_loop(int site, int level)
+{
+  uint32_t pc = site_pc(GEN_LOOP, site, level);
+  uint32_t head = pc - 0x10;
+  int trips = trip_count();
+  for (int i = 0; i < trips && records < maxRecords; i++)
+  {
+    if (level + 1 < nestDepth)
+    {
+      gen_loop(site, level + 1);
+    }
+    emit(pc, head, i + 1 < trips, 1, 0, 0, 1);   // backward branch, falls through on exit
+  }
+}
+
+static void gen_corr(int site)
+{
+  uint32_t pc = site_pc(GEN_CORR, site, 0);
+  int a = gen_range(2);
+  int b = (gen_range(100) < (uint32_t)corrNoise) ? !a : a;
+  // second branch repeats the first, with an uncorrelated branch between
+  emit(pc, pc + 0x40, a, 1, 0, 0, 1);
+  emit(pc + 0x20, pc + 0x40, gen_range(2), 1, 0, 0, 1);
+  emit(pc + 0x60, pc + 0x80, b, 1, 0, 0, 1);
+}
+
+static void gen_bias(int site)
+{
+  uint32_t pc = site_pc(GEN_BIAS, site, 0);
+  // half of the sites are biased towards taken, half towards not taken
+  int percent = (site & 1) ? biasPercent : 100 - biasPercent;
+  emit(pc, pc + 0x40, gen_range(100) < (uint32_t)percent, 1, 0, 0, 1);
+}
+
+static void gen_call(int site, int depth)
+{
+  uint32_t pc = site_pc(GEN_CALL, site, depth);
+  uint32_t callee = site_pc(GEN_CALL, site, depth + 1) - 0x10;
+  if (!emit(pc, callee, 1, 0, 1, 0, 1))
+  {
+    return;
+  }
+  if (depth + 1 < callDepth && gen_range(2))
+  {
+    gen_call(site, depth + 1);
+  }
+  else
+  {
+    gen_bias(site);   // some work in the leaf
+  }
+  // ret returns right after the 5-byte direct call
+  emit(callee + 0x18, pc + 5, 1, 0, 0, 1, 0);
+}
+
+static void gen_switch(int site)
+{
+  uint32_t pc = site_pc(GEN_SWITCH, site, 0);
+  int next;
+  if (gen_range(100) < (uint32_t)switchLocality)
+  {
+    next = (switch_last[site] + 1) % switchCases;   // bytecode-like sequence
+  }
+  else
+  {
+    next = gen_range(switchCases);
+  }
+  switch_last[site] = next;
+  uint32_t target = pc + 0x100 + next * 0x40;
+  if (emit(pc, target, 1, 0, 0, 0, 0))
+  {
+    emit(target + 0x30, pc - 0x20, 1, 0, 0, 0, 1);   // jump back to the dispatch loop
+  }
+}
+
+// Write the generalInfo style counts next to the trace
+void write_info()
+{
+  FILE *f = fopen(infoFile, "w");
+  if (!f)
+  {
+    fprintf(stderr, "Could not open %s\n", infoFile);
+    return;
+  }
+  fprintf(f, "!!! Number of Instructions = %llu\n", (unsigned long long)(records * bbSize));
+  fprintf(f, "!!! Number of Unconditional branches = %llu\n", (unsigned long long)ubcount);
+  fprintf(f, "!!! Number of Conditional branches = %llu\n", (unsigned long long)cbcount);
+  fprintf(f, "!!! Number of Call branches = %llu\n", (unsigned long long)callcount);
+  fprintf(f, "!!! Number of Ret branches = %llu\n", (unsigned long long)retcount);
+  fclose(f);
+}
+
+void usage()
+{
+  fprintf(stderr, "Usage: tracegen <options> | bzip2 > trace.bz2\n");
+  fprintf(stderr, " Options:\n");
+  fprintf(stderr, " --help             Print this message\n");
+  fprintf(stderr, " --seed:<n>         Random seed (default 1)\n");
+  fprintf(stderr, " --records:<n>      Records to emit (default 10000000)\n");
+  fprintf(stderr, " --mix:<kind>=<w>,...\n"
+                  "                    Weights of loop, corr, bias, call, switch\n"
+                  "                    (default loop=4,corr=2,bias=2,call=1,switch=1)\n");
+  fprintf(stderr, " --sites:<n>        Static instances of each pattern (default 64)\n");
+  fprintf(stderr, " --trip:<min>[:<max>]\n"
+                  "                    Loop trip counts, fixed without <max>\n");
+  fprintf(stderr, " --nest:<n>         Loop nesting depth (default 2)\n");
+  fprintf(stderr, " --bias:<percent>   Taken percentage of biased branches (default 90)\n");
+  fprintf(stderr, " --noise:<percent>  Correlated pairs that disagree (default 0)\n");
+  fprintf(stderr, " --calls:<n>        Deepest call chain (default 4)\n");
+  fprintf(stderr, " --cases:<n>        Targets per switch (default 16)\n");
+  fprintf(stderr, " --locality:<percent>\n"
+                  "                    Dispatches to the case after the previous one\n");
+  fprintf(stderr, " --info:<file>      Write instruction/branch counts to <file>\n");
+  fprintf(stderr, " --bb:<n>           Instructions per branch for --info (default 6)\n");
+  fprintf(stderr, " --binary           Write binary records (see bintrace.h)\n");
+}
+
+// Parse 'kind=weight,...'
+//
+// Returns True if Successful
+//
+int parse_mix(char *arg)
+{
+  for (int k = 0; k < GEN_KINDS; k++)
+  {
+    weight[k] = 0;
+  }
+  for (char *tok = strtok(arg, ","); tok; tok = strtok(NULL, ","))
+  {
+    char *eq = strchr(tok, '=');
+    if (!eq)
+    {
+      return 0;
+    }
+    *eq = '\0';
+    int k;
+    for (k = 0; k < GEN_KINDS && strcmp(tok, genName[k]); k++)
+      ;
+    if (k == GEN_KINDS)
+    {
+      return 0;
+    }
+    weight[k] = atoi(eq + 1);
+    if (weight[k] < 0)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int handle_option(char *arg)
+{
+  if (!strncmp(arg, "--seed:", 7))
+  {
+    seed = strtoull(arg + 7, NULL, 0);
+  }
+  else if (!strncmp(arg, "--records:", 10))
+  {
+    maxRecords = strtoull(arg + 10, NULL, 0);
+  }
+  else if (!strncmp(arg, "--mix:", 6))
+  {
+    return parse_mix(arg + 6);
+  }
+  else if (!strncmp(arg, "--sites:", 8))
+  {
+    sites = atoi(arg + 8);
+    return sites > 0 && sites <= 256;
+  }
+  else if (!strncmp(arg, "--trip:", 7))
+  {
+    if (sscanf(arg + 7, "%d:%d", &tripMin, &tripMax) == 1)
+    {
+      tripMax = tripMin;
+    }
+    return tripMin > 0 && tripMax >= tripMin;
+  }
+  else if (!strncmp(arg, "--nest:", 7))
+  {
+    nestDepth = atoi(arg + 7);
+    return nestDepth > 0 && nestDepth <= MAX_NEST;
+  }
+  else if (!strncmp(arg, "--bias:", 7))
+  {
+    biasPercent = atoi(arg + 7);
+    return biasPercent >= 0 && biasPercent <= 100;
+  }
+  else if (!strncmp(arg, "--noise:", 8))
+  {
+    corrNoise = atoi(arg + 8);
+    return corrNoise >= 0 && corrNoise <= 100;
+  }
+  else if (!strncmp(arg, "--calls:", 8))
+  {
+    callDepth = atoi(arg + 8);
+    return callDepth > 0 && callDepth < 2048;
+  }
+  else if (!strncmp(arg, "--cases:", 8))
+  {
+    switchCases = atoi(arg + 8);
+    return switchCases > 0 && switchCases <= MAX_CASES;
+  }
+  else if (!strncmp(arg, "--locality:", 11))
+  {
+    switchLocality = atoi(arg + 11);
+    return switchLocality >= 0 && switchLocality <= 100;
+  }
+  else if (!strncmp(arg, "--info:", 7))
+  {
+    infoFile = arg + 7;
+  }
+  else if (!strncmp(arg, "--bb:", 5))
+  {
+    bbSize = atoi(arg + 5);
+    return bbSize > 0;
+  }
+  else if (!strcmp(arg, "--binary"))
+  {
+    binaryOutput = 1;
+  }
+  else
+  {
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      usage();
+      exit(0);
+    }
+    else if (!handle_option(argv[i]))
+    {
+      fprintf(stderr, "Unrecognized option %s\n", argv[i]);
+      usage();
+      exit(1);
+    }
+  }
+
+  int total_weight = 0;
+  for (int k = 0; k < GEN_KINDS; k++)
+  {
+    total_weight += weight[k];
+  }
+  if (total_weight <= 0)
+  {
+    fprintf(stderr, "Empty pattern mix\n");
+    exit(1);
+  }
+
+  // large output buffer, records are streamed and never kept
+  static char outbuf[1 << 20];
+  setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+  if (binaryOutput)
+  {
+    // the whole synthetic program is traced: no offset, no limit
+    bt_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BT_MAGIC, 4);
+    header.version = BT_VERSION;
+    header.addr_bytes = 8;
+    header.record_bytes = 0;
+    header.limit = -1;
+    fwrite(&header, sizeof(header), 1, stdout);
+  }
+
+  rng_state = seed ? seed : 1;
+  switch_last = (uint8_t *)calloc(sites, sizeof(uint8_t));
+
+  while (records < maxRecords)
+  {
+    int pick = gen_range(total_weight);
+    int kind = 0;
+    while (pick >= weight[kind])
+    {
+      pick -= weight[kind++];
+    }
+    int site = gen_range(sites);
+
+    switch (kind)
+    {
+    case GEN_LOOP:
+      gen_loop(site, 0);
+      break;
+    case GEN_CORR:
+      gen_corr(site);
+      break;
+    case GEN_BIAS:
+      gen_bias(site);
+      break;
+    case GEN_CALL:
+      gen_call(site, 0);
+      break;
+    case GEN_SWITCH:
+      gen_switch(site);
+      break;
+    }
+  }
+  fflush(stdout);
+
+  if (infoFile)
+  {
+    write_info();
+  }
+  free(switch_last);
+
+  return 0;
+}
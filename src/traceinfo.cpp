@@ -0,0 +1,90 @@
+//========================================================//
+//  traceinfo.cpp                                         //
+//  Source file for the trace sidecar files               //
+//                                                        //
+//  Parses the '!!! Number of <what> = <n>' lines of a    //
+//  sidecar and cross-checks them against a run           //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include "traceinfo.h"
+
+//------------------------------------//
+//      Trace Info Configuration      //
+//------------------------------------//
+const char *infoCountName[NUM_INFO_COUNTS] = {"Instructions", "Unconditional branches",
+                                              "Conditional branches", "Call branches",
+                                              "Ret branches"};
+
+const char *traceInfoFile = NULL;
+
+//------------------------------------//
+//       Trace Info Functions         //
+//------------------------------------//
+
+int load_trace_info(const char *trace, uint64_t *counts)
+{
+  char path[4096];
+  if (traceInfoFile)
+  {
+    snprintf(path, sizeof(path), "%s", traceInfoFile);
+  }
+  else
+  {
+    // replace the extension (.bz2, .trace, ...) of the trace file name
+    snprintf(path, sizeof(path), "%s", trace);
+    char *dot = strrchr(path, '.');
+    char *slash = strrchr(path, '/');
+    if (dot && (!slash || dot > slash))
+    {
+      *dot = '\0';
+    }
+    strncat(path, ".txt", sizeof(path) - strlen(path) - 1);
+    if (!strcmp(path, trace))
+    {
+      return 0;   // the trace itself is a .txt file
+    }
+  }
+
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    if (traceInfoFile)
+    {
+      fprintf(stderr, "Cannot read %s\n", traceInfoFile);
+    }
+    return 0;
+  }
+  memset(counts, 0, NUM_INFO_COUNTS * sizeof(uint64_t));
+  char line[256];
+  while (fgets(line, sizeof(line), f))
+  {
+    for (int i = 0; i < NUM_INFO_COUNTS; i++)
+    {
+      char prefix[64];
+      snprintf(prefix, sizeof(prefix), "!!! Number of %s = ", infoCountName[i]);
+      if (!strncmp(line, prefix, strlen(prefix)))
+      {
+        counts[i] = strtoull(line + strlen(prefix), NULL, 10);
+      }
+    }
+  }
+  fclose(f);
+  return 1;
+}
+
+int check_trace_info(uint64_t *expected, uint64_t *read)
+{
+  int mismatches = 0;
+  // the instruction count cannot be checked from branch records
+  for (int i = INFO_UNCONDITIONAL; i < NUM_INFO_COUNTS; i++)
+  {
+    if (expected[i] != read[i])
+    {
+      printf("Sidecar mismatch: %s read %llu, sidecar %llu\n", infoCountName[i],
+             (unsigned long long)read[i], (unsigned long long)expected[i]);
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
@@ -0,0 +1,50 @@
+//========================================================//
+//  traceinfo.h                                           //
+//  Header file for the trace sidecar files               //
+//                                                        //
+//  traces/<name>.txt holds the instruction and branch    //
+//  counts written by the extractor next to <name>.bz2    //
+//========================================================//
+
+#ifndef TRACEINFO_H
+#define TRACEINFO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//        Trace Info Defines          //
+//------------------------------------//
+#define INFO_INSTRUCTIONS 0
+#define INFO_UNCONDITIONAL 1
+#define INFO_CONDITIONAL 2
+#define INFO_CALLS 3
+#define INFO_RETS 4
+#define NUM_INFO_COUNTS 5
+extern const char *infoCountName[];
+
+//------------------------------------//
+//      Trace Info Configuration      //
+//------------------------------------//
+extern const char *traceInfoFile;  // sidecar given with --info, else derived
+                                   // from the trace name
+
+//------------------------------------//
+//    Trace Info Function Prototypes  //
+//------------------------------------//
+
+// Load the sidecar of 'trace' ('<trace without extension>.txt'), or
+// traceInfoFile when set. Counts missing from the file are left at 0
+//
+// Returns True if a sidecar was read
+//
+int load_trace_info(const char *trace, uint64_t *counts);
+
+// Compare the sidecar counts with the counts of the records read and
+// print every mismatch
+//
+// Returns the number of mismatches
+//
+int check_trace_info(uint64_t *expected, uint64_t *read);
+
+#endif